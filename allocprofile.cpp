@@ -0,0 +1,162 @@
+#include "allocprofile.h"
+
+#include <cstdio>
+
+NAMESPACE_BEGIN
+
+thread_local AllocProfile* AllocProfile::current_ = NULL;
+
+static const char* const TYPE_NAMES[] = {
+	"undefined", "null", "boolean", "number", "string", "object",
+	"function", "array", "typedarray", "signal"
+};
+
+static const char* const NODE_NAMES[] = {
+	"program", "function", "identifier", "empty", "var", "declaration",
+	"block", "if", "switch", "case", "do", "while", "for", "for-in",
+	"return", "break", "continue", "with", "try", "throw", "group",
+	"unary", "binary", "ternary", "new", "index", "member", "call",
+	"bool", "number", "string", "null", "keyword", "array", "object",
+	"regexp"
+};
+
+AllocProfile::~AllocProfile()
+{
+	stop();
+}
+
+void AllocProfile::start(uint32_t rate)
+{
+	active_ = true;
+	rate_ = countdown_ = std::max<uint32_t>(1, rate);
+	expect_ = false;
+	pending_ = NULL;
+	top_ = Frame();
+	outer_.clear();
+	current_ = this;
+}
+
+void AllocProfile::stop()
+{
+	while (!outer_.empty())
+	{
+		pop();
+	}
+	pop();
+	active_ = false;
+	if (current_ == this)
+	{
+		current_ = NULL;
+	}
+}
+
+/* A child node's blocks are its own; the parent's open value resumes after it */
+void AllocProfile::push()
+{
+	busy_ = true;
+	outer_.push_back(top_);
+	busy_ = false;
+	top_ = Frame();
+}
+
+/* Charges the node's unclaimed blocks to the node itself */
+void AllocProfile::pop()
+{
+	if (top_.looseCount_ > 0)
+	{
+		busy_ = true;
+		Site& s = sites_[std::make_pair(at_, int(INTERNAL))];
+		busy_ = false;
+		s.count_ += top_.looseCount_;
+		s.bytes_ += top_.loose_;
+	}
+
+	if (outer_.empty())
+	{
+		top_ = Frame();
+		return;
+	}
+	top_ = outer_.back();
+	outer_.pop_back();
+}
+
+void AllocProfile::allocated(void* p, size_t bytes)
+{
+	if (busy_)
+	{
+		return;
+	}
+
+	if (expect_)
+	{
+		expect_ = false;
+		top_.open_ = false;
+		pending_ = p;
+		pendingBytes_ = bytes;
+	}
+	else if (top_.open_)
+	{
+		if (top_.site_)
+		{
+			top_.site_->bytes_ += bytes * rate_;
+		}
+	}
+	else
+	{
+		top_.loose_ += bytes;
+		++top_.looseCount_;
+	}
+}
+
+void AllocProfile::constructed(void* p, int type)
+{
+	if (p != pending_)
+	{
+		return;
+	}
+	pending_ = NULL;
+	top_.open_ = true;
+	top_.site_ = NULL;
+
+	size_t bytes = pendingBytes_ + top_.loose_;
+	top_.loose_ = top_.looseCount_ = 0;
+
+	if (--countdown_ > 0)
+	{
+		return;
+	}
+	countdown_ = rate_;
+
+	busy_ = true;
+	Site* site = top_.site_ = &sites_[std::make_pair(at_, type)];
+	busy_ = false;
+
+	site->count_ += rate_;
+	site->bytes_ += bytes * rate_;
+}
+
+void AllocProfile::write(std::ostream& out, size_t top)
+{
+	std::vector<std::pair<std::pair<AST*, int>, Site>> rows(sites_.begin(), sites_.end());
+	std::sort(rows.begin(), rows.end(),
+		[](const std::pair<std::pair<AST*, int>, Site>& a, const std::pair<std::pair<AST*, int>, Site>& b) {
+			return a.second.bytes_ > b.second.bytes_;
+		});
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%12s %10s  %-10s %-9s %s\n", "bytes", "count", "type", "node", "site");
+	out << buf;
+
+	for (size_t i = 0; i < rows.size() && i < top; ++i)
+	{
+		AST* at = rows[i].first.first;
+		int type = rows[i].first.second;
+		snprintf(buf, sizeof(buf), "%12llu %10llu  %-10s %-9s %s\n",
+			(unsigned long long)rows[i].second.bytes_, (unsigned long long)rows[i].second.count_,
+			type == INTERNAL ? "internal" : TYPE_NAMES[type], at ? NODE_NAMES[at->type_] : "-",
+			at ? at->range_.toString().c_str() : "(runtime)");
+		out << buf;
+	}
+}
+
+NAMESPACE_END
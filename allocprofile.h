@@ -0,0 +1,104 @@
+#ifndef _ALLOCPROFILE_H_
+#define _ALLOCPROFILE_H_
+
+#include "common.h"
+#include "ast.h"
+
+#include <map>
+
+NAMESPACE_BEGIN
+
+/*
+ * Opt-in allocation tracking for the thread's running VM. The global
+ * operator new reports every block, and the Value constructor charges
+ * the value's own block with its type to the AST node the VM is
+ * executing. Blocks allocated at the same node just before or after a
+ * value, such as its string payload, property map and shared_ptr control
+ * block, are charged to that value's site too; the rest show as internal
+ * allocations of the node. Counts are values, or blocks for internal
+ * rows. With a sampling rate n only every n-th value is recorded,
+ * weighted by n.
+ */
+class AllocProfile {
+public:
+	struct Site {
+		uint64_t count_;
+		uint64_t bytes_;
+
+		Site(): count_(0), bytes_(0)
+		{}
+	};
+
+	/* The type of blocks that belong to no value */
+	static const int INTERNAL = -1;
+
+private:
+	static thread_local AllocProfile* current_;
+
+	bool active_;
+	/* Set while recording, whose own allocations must not be reported */
+	bool busy_;
+	AST* at_;
+	uint32_t rate_;
+	uint32_t countdown_;
+	/* The next block is a Value's */
+	bool expect_;
+	void* pending_;
+	size_t pendingBytes_;
+	struct Frame {
+		/* A value was constructed at the node; its site, or NULL if not sampled */
+		bool open_;
+		Site* site_;
+		/* Blocks at the node not yet claimed by a value */
+		size_t loose_;
+		uint32_t looseCount_;
+	};
+
+	/* The node being executed, then the nodes enclosing it */
+	Frame top_;
+	std::vector<Frame> outer_;
+	std::map<std::pair<AST*, int>, Site> sites_;
+
+	void push();
+	void pop();
+
+public:
+	AllocProfile(): active_(false), busy_(false), at_(NULL), rate_(1), countdown_(1), expect_(false),
+		pending_(NULL), pendingBytes_(0), top_()
+	{}
+	~AllocProfile();
+
+	void start(uint32_t rate = 1);
+	void stop();
+
+	inline bool active() { return active_; }
+	static inline AllocProfile* current() { return current_; }
+
+	inline AST* enter(AST* at)
+	{
+		AST* prev = at_;
+		push();
+		at_ = at;
+		return prev;
+	}
+	inline void leave(AST* prev)
+	{
+		pop();
+		at_ = prev;
+	}
+
+	/* Called by Value's operator new before it takes its block */
+	inline void expectValue()
+	{
+		expect_ = true;
+	}
+	void allocated(void* p, size_t bytes);
+	void constructed(void* p, int type);
+
+	inline const std::map<std::pair<AST*, int>, Site>& sites() { return sites_; }
+	void write(std::ostream& out, size_t top = 40);
+};
+
+NAMESPACE_END
+
+#endif
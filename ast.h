@@ -3,10 +3,14 @@
 
 #include "common.h"
 #include "lexer.h"
+#include "atom.h"
 
 NAMESPACE_BEGIN
 
 class Scope;
+class LoopTrace;
+class Value;
+class Function;
 
 struct AST {
 	enum Type {
@@ -59,20 +63,76 @@ struct AST {
 	{}
 };
 
+struct LoopInfo {
+	int hits_;
+	int exits_;
+	int records_;
+	bool blacklisted_;
+	LoopTrace* trace_;
+
+	LoopInfo(): hits_(0), exits_(0), records_(0), blacklisted_(false), trace_(NULL)
+	{}
+};
+
 class Identifier: public AST {
 public:
+	/* Where the parser resolved the name; GLOBAL goes through the scope chain */
+	enum Binding {
+		GLOBAL,
+		SLOT,
+		CELL
+	};
+
 	std::string name_;
+	Atom atom_;
+	Binding binding_;
+	int index_;
+	int depth_;
 
 public:
-	Identifier(Token tok): AST(AST::Type::IDENTIFIER, tok.range_), name_(tok.data_)
+	Identifier(Token tok): AST(AST::Type::IDENTIFIER, tok.range_), name_(tok.data_),
+		atom_(atom(tok.data_)), binding_(Binding::GLOBAL), index_(0), depth_(0)
 	{}
 	~Identifier()
 	{}
 };
 
+/*
+ * Storage plan of one function, filled in by the parser. Locals that no
+ * inner function refers to get frame slots; captured ones get cells in
+ * an Env the activation shares with the closures it creates. depth_ of a
+ * CELL counts the enclosing functions that own an Env. The arguments
+ * object is only built for bodies that mention it.
+ */
+struct FrameLayout {
+	FrameLayout* parent_;
+	std::unordered_map<Atom, int> locals_;
+	std::vector<bool> captured_;
+	std::vector<int> index_;
+	std::list<Function*> hoisted_;
+	int nslots_;
+	int ncells_;
+	bool arguments_;
+
+	FrameLayout(FrameLayout* parent): parent_(parent), nslots_(0), ncells_(0),
+		arguments_(false)
+	{}
+
+	void declare(Atom name)
+	{
+		if (locals_.find(name) == locals_.end())
+		{
+			locals_[name] = captured_.size();
+			captured_.push_back(false);
+		}
+	}
+};
+
 class Program: public AST {
 public:
 	std::list<AST*>* stmts_;
+	std::list<Function*> hoisted_;
+	std::vector<std::shared_ptr<Value>> consts_;
 
 public:
 	Program(PositionRange range, std::list<AST*>* stmts):
@@ -89,14 +149,18 @@ public:
 	Identifier* id_;
 	std::list<Identifier*>* args_;
 	std::list<AST*>* stmts_;
+	FrameLayout* layout_;
+	bool declaration_;
 
 public:
 	Function(PositionRange range, Identifier* id,
 		std::list<Identifier*>* args, std::list<AST*>* stmts):
-		AST(AST::Type::FUNCTION, range), id_(id), args_(args), stmts_(stmts)
+		AST(AST::Type::FUNCTION, range), id_(id), args_(args), stmts_(stmts),
+		layout_(NULL), declaration_(false)
 	{}
 	~Function()
 	{
+		deletePtr(layout_);
 		deletePtr(id_);
 		deletePtr(args_);
 		deletePtr(stmts_);
@@ -221,6 +285,7 @@ class Loop: public AST {
 public:
 	AST* cond_;
 	AST* stmt_;
+	LoopInfo hot_;
 
 public:
 	Loop(PositionRange range, AST* cond, AST* stmt):
@@ -239,6 +304,7 @@ public:
 	AST* cond_;
 	AST* iter_;
 	AST* stmt_;
+	LoopInfo hot_;
 
 public:
 	ForLoop(PositionRange range, AST* init, AST* cond, AST* iter, AST* stmt):
@@ -387,14 +453,100 @@ public:
 
 class BiExpression: public AST {
 public:
+	enum Op {
+		PLUS,
+		MINUS,
+		MUL,
+		DIV,
+		MOD,
+		BAND,
+		BOR,
+		BXOR,
+		LSHIFT,
+		RSHIFT,
+		LS,
+		LE,
+		GT,
+		GE,
+		EQ,
+		NEQ,
+		TEQ,
+		NTEQ,
+		REV,
+		ASSIGN,
+		AND,
+		OR,
+		UNKNOWN
+	};
+
+	enum Kind {
+		UNINIT,
+		NUM_NUM,
+		STR_STR,
+		GENERIC
+	};
+
 	AST* left_;
 	std::string op_;
 	AST* right_;
+	Op opcode_;
+	bool compound_;
+	Kind kind_;
+
+	static Op decode(const std::string& op, bool& compound)
+	{
+		static const std::unordered_map<std::string, std::pair<Op, bool>> OPS = {
+			{ "+", { Op::PLUS, false } },
+			{ "-", { Op::MINUS, false } },
+			{ "*", { Op::MUL, false } },
+			{ "/", { Op::DIV, false } },
+			{ "%", { Op::MOD, false } },
+			{ "&", { Op::BAND, false } },
+			{ "|", { Op::BOR, false } },
+			{ "^", { Op::BXOR, false } },
+			{ "<<", { Op::LSHIFT, false } },
+			{ ">>", { Op::RSHIFT, false } },
+			{ "<", { Op::LS, false } },
+			{ "<=", { Op::LE, false } },
+			{ ">", { Op::GT, false } },
+			{ ">=", { Op::GE, false } },
+			{ "==", { Op::EQ, false } },
+			{ "!=", { Op::NEQ, false } },
+			{ "===", { Op::TEQ, false } },
+			{ "!==", { Op::NTEQ, false } },
+			{ "=", { Op::ASSIGN, false } },
+			{ "&&", { Op::AND, false } },
+			{ "||", { Op::OR, false } },
+			{ "+=", { Op::PLUS, true } },
+			{ "-=", { Op::MINUS, true } },
+			{ "*=", { Op::MUL, true } },
+			{ "/=", { Op::DIV, true } },
+			{ "%=", { Op::MOD, true } },
+			{ "&=", { Op::BAND, true } },
+			{ "|=", { Op::BOR, true } },
+			{ "~=", { Op::REV, true } },
+			{ "^=", { Op::BXOR, true } },
+			{ "<<=", { Op::LSHIFT, true } },
+			{ ">>=", { Op::RSHIFT, true } },
+		};
+
+		auto r = OPS.find(op);
+		if (r == OPS.end())
+		{
+			compound = false;
+			return Op::UNKNOWN;
+		}
+		compound = r->second.second;
+		return r->second.first;
+	}
 
 public:
 	BiExpression(PositionRange range, AST* left, Token op, AST* right):
-		AST(AST::Type::BIN_EXPR, range), left_(left), op_(op.data_), right_(right)
-	{}
+		AST(AST::Type::BIN_EXPR, range), left_(left), op_(op.data_), right_(right),
+		kind_(Kind::UNINIT)
+	{
+		opcode_ = decode(op_, compound_);
+	}
 	~BiExpression()
 	{
 		deletePtr(left_);
@@ -487,28 +639,33 @@ public:
 class LiteralBool: public AST {
 public:
 	bool b_;
+	int const_;
 
 public:
-	LiteralBool(Token b): AST(AST::Type::LITERAL_BOOL, b.range_), b_(b.data_ == "true")
+	LiteralBool(Token b): AST(AST::Type::LITERAL_BOOL, b.range_), b_(b.data_ == "true"),
+		const_(-1)
 	{}
 };
 
 class LiteralNumber: public AST {
 public:
 	std::string data_;
+	int const_;
 
 public:
-	LiteralNumber(Token n): AST(AST::Type::LITERAL_NUMBER, n.range_), data_(n.data_)
+	LiteralNumber(Token n): AST(AST::Type::LITERAL_NUMBER, n.range_), data_(n.data_),
+		const_(-1)
 	{}
 };
 
 class LiteralString: public AST {
 public:
 	std::string str_;
+	int const_;
 
 public:
 	LiteralString(Token s): AST(AST::Type::LITERAL_STRING, s.range_),
-		str_(s.data_.substr(1, s.data_.length()-2))
+		str_(s.data_.substr(1, s.data_.length()-2)), const_(-1)
 	{}
 };
 
@@ -521,9 +678,11 @@ public:
 class Keyword: public AST {
 public:
 	std::string data_;
+	Atom atom_;
 
 public:
-	Keyword(Token n): AST(AST::Type::KEYWORD, n.range_), data_(n.data_)
+	Keyword(Token n): AST(AST::Type::KEYWORD, n.range_), data_(n.data_),
+		atom_(atom(n.data_))
 	{}
 };
 
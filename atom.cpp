@@ -0,0 +1,92 @@
+#include "atom.h"
+#include "memory.h"
+
+#include <stdexcept>
+
+NAMESPACE_BEGIN
+
+AtomTable::AtomTable(): chunks_(), size_(0)
+{
+	MemoryAccount::Suspend none;
+	for (uint32_t i = 0; i < INDEX_CACHE; ++i)
+	{
+		indices_[i] = insert(std::to_string(i));
+	}
+}
+
+AtomTable& AtomTable::instance()
+{
+	static AtomTable inst;
+	return inst;
+}
+
+/* Adds a name not yet in ids_; the caller holds lock_ or is the constructor */
+Atom AtomTable::insert(const std::string& name)
+{
+	Atom a = size_.load(std::memory_order_relaxed);
+
+	if (a / CHUNK >= MAX_CHUNKS)
+	{
+		throw std::length_error("atom table full");
+	}
+	if (chunks_[a / CHUNK] == NULL)
+	{
+		chunks_[a / CHUNK] = new const std::string*[CHUNK];
+	}
+
+	auto ins = ids_.emplace(name, a);
+	chunks_[a / CHUNK][a % CHUNK] = &ins.first->first;
+	size_.store(a + 1, std::memory_order_release);
+	return a;
+}
+
+/*
+ * Names this thread has looked up. A miss is remembered with the table
+ * size it was seen at and holds only until the table grows. Like the
+ * table, the memo is charged to no VM's account.
+ */
+struct Memo {
+	struct Entry {
+		Atom atom_;
+		uint32_t size_;
+	};
+
+	std::unordered_map<std::string, Entry> names_;
+};
+
+Atom AtomTable::lookup(const std::string& name, bool add)
+{
+	static thread_local Memo memo;
+
+	uint32_t size = size_.load(std::memory_order_acquire);
+	auto r = memo.names_.find(name);
+	if (r != memo.names_.end()
+		&& (r->second.atom_ != NO_ATOM || (!add && r->second.size_ == size)))
+	{
+		return r->second.atom_;
+	}
+
+	MemoryAccount::Suspend none;
+	Atom a;
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		auto found = ids_.find(name);
+		a = found != ids_.end() ? found->second : add ? insert(name) : NO_ATOM;
+	}
+
+	if (r != memo.names_.end())
+	{
+		r->second = Memo::Entry{ a, size };
+	}
+	else
+	{
+		if (memo.names_.size() >= MEMO_LIMIT)
+		{
+			memo.names_.clear();
+		}
+		memo.names_.emplace(name, Memo::Entry{ a, size });
+	}
+	return a;
+}
+
+NAMESPACE_END
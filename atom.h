@@ -0,0 +1,137 @@
+#ifndef _ATOM_H_
+#define _ATOM_H_
+
+#include "common.h"
+
+#include <atomic>
+#include <mutex>
+
+NAMESPACE_BEGIN
+
+/*
+ * Interned names. Every identifier and fixed property name in a program
+ * is stored once and referred to by a small integer, so scopes and
+ * objects hash and compare integers instead of strings. Names computed
+ * at run time are only looked up, never added, so the table is bounded
+ * by the program text rather than by the data it processes.
+ *
+ * The table is shared by every thread. Names live in fixed chunks that
+ * never move, so reading a name takes no lock; lookups go through a
+ * bounded per-thread memo and take the lock only for names the thread
+ * has not seen since the table last grew.
+ */
+typedef uint32_t Atom;
+
+static const Atom NO_ATOM = UINT32_MAX;
+
+class AtomTable {
+public:
+	static const uint32_t INDEX_CACHE = 4096;
+	static const uint32_t CHUNK = 4096;
+	static const uint32_t MAX_CHUNKS = 4096;
+	/* Names remembered per thread before the memo is dropped */
+	static const uint32_t MEMO_LIMIT = 4096;
+
+private:
+	std::mutex lock_;
+	std::unordered_map<std::string, Atom> ids_;
+	const std::string** chunks_[MAX_CHUNKS];
+	std::atomic<uint32_t> size_;
+	Atom indices_[INDEX_CACHE];
+
+	AtomTable();
+
+	Atom insert(const std::string& name);
+	Atom lookup(const std::string& name, bool add);
+
+public:
+	static AtomTable& instance();
+
+	/* For names in the program text and the builtins only */
+	inline Atom intern(const std::string& name)
+	{
+		return lookup(name, true);
+	}
+	/* The atom for name if it has been interned, otherwise NO_ATOM */
+	inline Atom find(const std::string& name)
+	{
+		return lookup(name, false);
+	}
+
+	/* Atoms for the indices below INDEX_CACHE */
+	inline Atom index(uint32_t i) const
+	{
+		return indices_[i];
+	}
+
+	inline const std::string& name(Atom a) const
+	{
+		return *chunks_[a / CHUNK][a % CHUNK];
+	}
+	inline size_t size() const
+	{
+		return size_.load(std::memory_order_acquire);
+	}
+};
+
+inline Atom atom(const std::string& name)
+{
+	return AtomTable::instance().intern(name);
+}
+
+inline const std::string& atomName(Atom a)
+{
+	return AtomTable::instance().name(a);
+}
+
+/*
+ * A property key: the atom when the name is interned, otherwise the name
+ * itself with its hash. Objects keep the second kind in a map keyed by
+ * Key, so a key that is kept, like a string value's, is hashed only once.
+ */
+struct Key {
+	Atom atom_;
+	std::string name_;
+	size_t hash_;
+
+	Key(Atom a): atom_(a), hash_(0)
+	{}
+	explicit Key(const std::string& name): atom_(NO_ATOM), name_(name),
+		hash_(std::hash<std::string>()(name))
+	{}
+
+	inline const std::string& name() const
+	{
+		return atom_ == NO_ATOM ? name_ : atomName(atom_);
+	}
+
+	inline bool operator==(const Key& rhs) const
+	{
+		return atom_ == rhs.atom_ && hash_ == rhs.hash_ && name_ == rhs.name_;
+	}
+
+	struct Hash {
+		inline size_t operator()(const Key& k) const
+		{
+			return k.hash_;
+		}
+	};
+};
+
+/* The key for a name computed at run time; never interns it */
+inline Key keyOf(const std::string& name)
+{
+	Atom a = AtomTable::instance().find(name);
+	return a == NO_ATOM ? Key(name) : Key(a);
+}
+
+/* The key for an array index, an atom for small indices */
+inline Key indexKey(uint32_t i)
+{
+	return i < AtomTable::INDEX_CACHE ? Key(AtomTable::instance().index(i))
+		: keyOf(std::to_string(i));
+}
+
+NAMESPACE_END
+
+#endif
@@ -0,0 +1,300 @@
+#include "vm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace cl;
+
+/*
+ * Engine benchmarks. Every script under the given directory runs in its
+ * own child process, so peak RSS is per benchmark; a script reports its
+ * work by assigning the global `ops`. The lexer and parser are timed over
+ * a large generated source. Each result is one JSON line:
+ *
+ *   {"bench":"fib","ops":57313,"seconds":0.41,"ops_per_sec":139790,"peak_rss_kb":5120}
+ *
+ * The scaling run repeats one script in 1, 2, 4 ... threads, each with its
+ * own parser and VM, and adds the threads and the speedup over one thread.
+ * It runs a second time with the sampling profiler on in every VM, so the
+ * state the profilers share is used from all threads at once.
+ *
+ * Usage: jsbench [-n repeats] [-t threads] [-s scaling-script] [dir]
+ */
+typedef std::chrono::steady_clock Clock;
+
+static const size_t SOURCE_COPIES = 20000;
+
+static double seconds(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static long peakRss()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+static void report(const std::string& name, double ops, double secs)
+{
+	printf("{\"bench\":\"%s\",\"ops\":%.0f,\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"peak_rss_kb\":%ld}\n",
+		name.c_str(), ops, secs, secs > 0 ? ops / secs : 0.0, peakRss());
+	fflush(stdout);
+}
+
+static void reportScaling(const std::string& name, int threads, double ops, double secs, double speedup)
+{
+	printf("{\"bench\":\"scaling.%s\",\"threads\":%d,\"ops\":%.0f,\"seconds\":%.6f,"
+		"\"ops_per_sec\":%.0f,\"speedup\":%.2f,\"peak_rss_kb\":%ld}\n",
+		name.c_str(), threads, ops, secs, secs > 0 ? ops / secs : 0.0, speedup, peakRss());
+	fflush(stdout);
+}
+
+static void discard(void* ctx, const char* data, size_t len)
+{}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream f(path);
+	std::stringstream ss;
+	ss << f.rdbuf();
+	return ss.str();
+}
+
+/* Parses and runs source in a fresh VM; returns the script's ops */
+static double runOnce(const std::string& source, bool profile = false)
+{
+	Lexer lex(source);
+	Parser ps(&lex);
+	VM vm;
+	vm.output().toCallback(discard, NULL);
+	if (profile)
+	{
+		vm.profiler().start();
+	}
+	vm.exec(ps.getProgram());
+
+	ValuePtr v = ps.getProgram()->scope_->getVar(atom("ops"));
+	return v ? v->toNumber() : 1;
+}
+
+static void runScript(const std::string& name, const std::string& source, int repeats)
+{
+	double best = 0;
+	double ops = 0;
+
+	for (int r = 0; r < repeats; ++r)
+	{
+		auto start = Clock::now();
+		ops = runOnce(source);
+		double secs = seconds(start);
+		best = r == 0 ? secs : std::min(best, secs);
+	}
+
+	report(name, ops, best);
+}
+
+static void runScaling(const std::string& name, const std::string& source, int maxThreads,
+	int repeats, bool profile)
+{
+	double base = 0;
+
+	for (int n = 1; n <= maxThreads; n = n < maxThreads && n * 2 > maxThreads ? maxThreads : n * 2)
+	{
+		double best = 0;
+		double ops = 0;
+
+		for (int r = 0; r < repeats; ++r)
+		{
+			std::vector<std::thread> threads;
+			std::vector<double> done(n, 0);
+			std::vector<std::exception_ptr> errors(n);
+			auto start = Clock::now();
+
+			for (int t = 0; t < n; ++t)
+			{
+				threads.emplace_back([&, t]() {
+					try
+					{
+						done[t] = runOnce(source, profile);
+					}
+					catch (...)
+					{
+						errors[t] = std::current_exception();
+					}
+				});
+			}
+			for (auto& t : threads)
+			{
+				t.join();
+			}
+			for (auto& e : errors)
+			{
+				if (e)
+				{
+					std::rethrow_exception(e);
+				}
+			}
+
+			double secs = seconds(start);
+			best = r == 0 ? secs : std::min(best, secs);
+			ops = 0;
+			for (double d : done)
+			{
+				ops += d;
+			}
+		}
+
+		double rate = best > 0 ? ops / best : 0;
+		base = n == 1 ? rate : base;
+		reportScaling(name, n, ops, best, base > 0 ? rate / base : 0);
+
+		if (n == maxThreads)
+		{
+			break;
+		}
+	}
+}
+
+static std::string generateSource()
+{
+	std::stringstream ss;
+
+	for (size_t i = 0; i < SOURCE_COPIES; ++i)
+	{
+		ss << "function f" << i << "(a, b) { var x = a + b * 2; "
+			<< "if (x > " << i << ") { return x - 1; } else { return \"s\" + x; } }\n"
+			<< "var o" << i << " = { k: " << i << ", s: \"str\", arr: [1, 2.5, 0x1f] };\n"
+			<< "for (var i = 0; i < 10; i++) { o" << i << ".k += f" << i << "(i, 3) % 7; }\n";
+	}
+	return ss.str();
+}
+
+static void runFrontEnd(int repeats)
+{
+	std::string source = generateSource();
+	double lexBest = 0, parseBest = 0;
+	size_t tokens = 0;
+
+	for (int r = 0; r < repeats; ++r)
+	{
+		auto start = Clock::now();
+		Lexer lex(source);
+		double lexSecs = seconds(start);
+
+		tokens = 0;
+		lex.restart();
+		while (lex.get().type_ != Token::Type::END_OF_FILE)
+		{
+			tokens++;
+		}
+
+		start = Clock::now();
+		Parser ps(&lex);
+		double parseSecs = seconds(start);
+
+		lexBest = r == 0 ? lexSecs : std::min(lexBest, lexSecs);
+		parseBest = r == 0 ? parseSecs : std::min(parseBest, parseSecs);
+	}
+
+	report("lexer.tokens", tokens, lexBest);
+	report("parser.statements", SOURCE_COPIES * 3, parseBest);
+}
+
+/* Runs fn in a child process so each benchmark gets its own peak RSS */
+template<typename Fn>
+static void isolated(const std::string& name, Fn fn)
+{
+	pid_t pid = fork();
+
+	if (pid == 0)
+	{
+		try
+		{
+			fn();
+		}
+		catch (std::exception& e)
+		{
+			printf("{\"bench\":\"%s\",\"error\":\"%s\"}\n", name.c_str(), e.what());
+			fflush(stdout);
+		}
+		_exit(0);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+}
+
+int main(int argc, char* argv[])
+{
+	int repeats = 3;
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string scaling = "objects";
+	std::string dir = "bench";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+		{
+			repeats = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+		{
+			threads = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+		{
+			scaling = argv[++i];
+		}
+		else
+		{
+			dir = argv[i];
+		}
+	}
+
+	std::vector<std::string> scripts;
+	DIR* d = opendir(dir.c_str());
+
+	if (d == NULL)
+	{
+		fprintf(stderr, "jsbench: cannot open %s\n", dir.c_str());
+		return 1;
+	}
+
+	while (struct dirent* e = readdir(d))
+	{
+		std::string file = e->d_name;
+		if (file.length() > 3 && file.compare(file.length() - 3, 3, ".js") == 0)
+		{
+			scripts.push_back(file);
+		}
+	}
+	closedir(d);
+	std::sort(scripts.begin(), scripts.end());
+
+	for (auto& file : scripts)
+	{
+		std::string name = file.substr(0, file.length() - 3);
+		std::string source = readFile(dir + "/" + file);
+
+		isolated(name, [&]() { runScript(name, source, repeats); });
+	}
+
+	isolated("frontend", [&]() { runFrontEnd(repeats); });
+
+	std::string source = readFile(dir + "/" + scaling + ".js");
+	isolated("scaling." + scaling, [&]() { runScaling(scaling, source, threads, repeats, false); });
+	isolated("scaling." + scaling + ".profiled", [&]() {
+		runScaling(scaling + ".profiled", source, threads, repeats, true);
+	});
+
+	return 0;
+}
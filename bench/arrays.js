@@ -0,0 +1,7 @@
+// Dense array fill and repeated indexed sums
+var n = 50000;
+var a = [];
+for (var i = 0; i < n; i++) { a[i] = i * 2; }
+var sum = 0;
+for (var r = 0; r < 4; r++) { for (var j = 0; j < n; j++) { sum += a[j]; } }
+var ops = n * 5;
@@ -0,0 +1,4 @@
+// Recursive calls: fib(22) makes 57313 calls
+function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+var result = fib(22);
+var ops = 57313;
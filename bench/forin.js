@@ -0,0 +1,7 @@
+// Key enumeration over a 100-property object
+var o = {};
+for (var k = 0; k < 100; k++) { o["key" + k] = k; }
+var n = 1000;
+var total = 0;
+for (var r = 0; r < n; r++) { for (var key in o) { total += 1; } }
+var ops = n * 100;
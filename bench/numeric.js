@@ -0,0 +1,7 @@
+// Tight numeric loops at top level and inside a function
+var n = 1000000;
+var sum = 0;
+for (var i = 0; i < n; i++) { sum = (sum + i * 3) % 1000003; }
+function mix(m) { var h = 7; for (var j = 0; j < m; j++) { h = (h * 31 + j) % 65521; } return h; }
+var hash = mix(n);
+var ops = n * 2;
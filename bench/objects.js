@@ -0,0 +1,10 @@
+// Constructor calls, property stores and loads
+function Point(x, y) { this.x = x; this.y = y; }
+var n = 50000;
+var acc = 0;
+for (var i = 0; i < n; i++) {
+	var p = new Point(i, i + 1);
+	p.z = p.x * p.y;
+	acc = (acc + p.z) % 65536;
+}
+var ops = n;
@@ -0,0 +1,7 @@
+// Repeated concatenation, then indexed reads of the result
+var n = 50000;
+var s = "";
+for (var i = 0; i < n; i++) { s += "ab"; }
+var c = 0;
+for (var j = 0; j < n; j++) { c += s.charCodeAt(j); }
+var ops = n * 2;
@@ -0,0 +1,14 @@
+// Switch dispatch inside a small interpreter loop
+function step(code, x) {
+	switch (code) {
+		case 0: return x + 1;
+		case 1: return x * 2;
+		case 2: return x - 3;
+		case 3: return x % 97;
+		default: return x;
+	}
+}
+var n = 50000;
+var x = 1;
+for (var i = 0; i < n; i++) { x = step(i % 5, x) % 100000; }
+var ops = n;
@@ -0,0 +1,69 @@
+#ifndef _BUDGET_H_
+#define _BUDGET_H_
+
+#include "common.h"
+
+#include <atomic>
+
+NAMESPACE_BEGIN
+
+/*
+ * Bounds how long a script runs. Every loop iteration (traced or not) and
+ * every call entry is one step; once the allowance is spent, or another
+ * thread raises interrupt(), the next step reports it and the VM unwinds
+ * with a TimeoutError. The interrupt flag is the only state shared across
+ * threads and stays raised until reset().
+ */
+class ExecBudget {
+public:
+	static const int64_t UNLIMITED = INT64_MAX;
+
+private:
+	int64_t left_;
+	int64_t limit_;
+	std::atomic<bool> interrupted_;
+
+public:
+	ExecBudget(): left_(UNLIMITED), limit_(UNLIMITED), interrupted_(false)
+	{}
+
+	/* Allows steps more steps and clears a pending interrupt */
+	inline void reset(int64_t steps = UNLIMITED)
+	{
+		left_ = limit_ = steps;
+		interrupted_.store(false, std::memory_order_relaxed);
+	}
+
+	/* Safe to call from any thread */
+	inline void interrupt()
+	{
+		interrupted_.store(true, std::memory_order_relaxed);
+	}
+
+	inline bool interrupted()
+	{
+		return interrupted_.load(std::memory_order_relaxed);
+	}
+	inline bool exhausted()
+	{
+		return left_ < 0;
+	}
+	inline int64_t limit()
+	{
+		return limit_;
+	}
+	inline int64_t used()
+	{
+		return limit_ - std::max<int64_t>(left_, 0);
+	}
+
+	/* True when the script must stop */
+	inline bool tick()
+	{
+		return --left_ < 0 || interrupted_.load(std::memory_order_relaxed);
+	}
+};
+
+NAMESPACE_END
+
+#endif
@@ -0,0 +1,677 @@
+#include "bulk.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BULK_X86
+#include <immintrin.h>
+#endif
+
+NAMESPACE_BEGIN
+
+template<typename T> struct Traits;
+
+template<> struct Traits<double> {
+	typedef double Acc;
+	typedef double Wrap;
+};
+
+template<> struct Traits<int32_t> {
+	typedef int64_t Acc;
+	typedef uint32_t Wrap;
+};
+
+template<> struct Traits<uint8_t> {
+	typedef uint64_t Acc;
+	typedef uint32_t Wrap;
+};
+
+/* Reference loops, also used for the tails of the vector versions */
+template<typename T>
+struct Scalar {
+	typedef typename Traits<T>::Acc Acc;
+	typedef typename Traits<T>::Wrap Wrap;
+
+	static void fill(T* dst, T v, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			dst[i] = v;
+		}
+	}
+
+	static Acc sum(const T* src, size_t n, Acc acc = 0)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			acc += src[i];
+		}
+		return acc;
+	}
+
+	static T min(const T* src, size_t n, T acc)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			acc = src[i] < acc ? src[i] : acc;
+		}
+		return acc;
+	}
+
+	static T max(const T* src, size_t n, T acc)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			acc = src[i] > acc ? src[i] : acc;
+		}
+		return acc;
+	}
+
+	static void add(T* dst, const T* src, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			dst[i] = T(Wrap(dst[i]) + Wrap(src[i]));
+		}
+	}
+
+	static void mul(T* dst, const T* src, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			dst[i] = T(Wrap(dst[i]) * Wrap(src[i]));
+		}
+	}
+};
+
+#ifdef BULK_X86
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+/* SSE2 */
+
+TARGET_SSE2 static void fillF64Sse2(double* dst, double v, size_t n)
+{
+	__m128d x = _mm_set1_pd(v);
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		_mm_storeu_pd(dst + i, x);
+	}
+	Scalar<double>::fill(dst + i, v, n - i);
+}
+
+TARGET_SSE2 static double sumF64Sse2(const double* src, size_t n)
+{
+	__m128d a = _mm_setzero_pd(), b = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		a = _mm_add_pd(a, _mm_loadu_pd(src + i));
+		b = _mm_add_pd(b, _mm_loadu_pd(src + i + 2));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(a, b));
+	return Scalar<double>::sum(src + i, n - i, lanes[0] + lanes[1]);
+}
+
+TARGET_SSE2 static double minF64Sse2(const double* src, size_t n)
+{
+	double init = std::numeric_limits<double>::infinity();
+	__m128d m = _mm_set1_pd(init);
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		m = _mm_min_pd(_mm_loadu_pd(src + i), m);
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, m);
+	return Scalar<double>::min(src + i, n - i, std::min(lanes[0], lanes[1]));
+}
+
+TARGET_SSE2 static double maxF64Sse2(const double* src, size_t n)
+{
+	double init = -std::numeric_limits<double>::infinity();
+	__m128d m = _mm_set1_pd(init);
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		m = _mm_max_pd(_mm_loadu_pd(src + i), m);
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, m);
+	return Scalar<double>::max(src + i, n - i, std::max(lanes[0], lanes[1]));
+}
+
+TARGET_SSE2 static void addF64Sse2(double* dst, const double* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		_mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i)));
+	}
+	Scalar<double>::add(dst + i, src + i, n - i);
+}
+
+TARGET_SSE2 static void mulF64Sse2(double* dst, const double* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		_mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i)));
+	}
+	Scalar<double>::mul(dst + i, src + i, n - i);
+}
+
+TARGET_SSE2 static void fillI32Sse2(int32_t* dst, int32_t v, size_t n)
+{
+	__m128i x = _mm_set1_epi32(v);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		_mm_storeu_si128((__m128i*)(dst + i), x);
+	}
+	Scalar<int32_t>::fill(dst + i, v, n - i);
+}
+
+TARGET_SSE2 static double sumI32Sse2(const int32_t* src, size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i sign = _mm_srai_epi32(v, 31);
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+	}
+	int64_t lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return double(Scalar<int32_t>::sum(src + i, n - i, lanes[0] + lanes[1]));
+}
+
+TARGET_SSE2 static inline __m128i minI32Sse2(__m128i a, __m128i b)
+{
+	__m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+TARGET_SSE2 static inline __m128i maxI32Sse2(__m128i a, __m128i b)
+{
+	__m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+TARGET_SSE2 static int32_t minI32Sse2(const int32_t* src, size_t n)
+{
+	__m128i m = _mm_set1_epi32(INT32_MAX);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		m = minI32Sse2(m, _mm_loadu_si128((const __m128i*)(src + i)));
+	}
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, m);
+	return Scalar<int32_t>::min(src + i, n - i, Scalar<int32_t>::min(lanes, 4, INT32_MAX));
+}
+
+TARGET_SSE2 static int32_t maxI32Sse2(const int32_t* src, size_t n)
+{
+	__m128i m = _mm_set1_epi32(INT32_MIN);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		m = maxI32Sse2(m, _mm_loadu_si128((const __m128i*)(src + i)));
+	}
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, m);
+	return Scalar<int32_t>::max(src + i, n - i, Scalar<int32_t>::max(lanes, 4, INT32_MIN));
+}
+
+TARGET_SSE2 static void addI32Sse2(int32_t* dst, const int32_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi32(a, b));
+	}
+	Scalar<int32_t>::add(dst + i, src + i, n - i);
+}
+
+TARGET_SSE2 static double sumU8Sse2(const uint8_t* src, size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	__m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(src + i)), zero));
+	}
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return double(Scalar<uint8_t>::sum(src + i, n - i, lanes[0] + lanes[1]));
+}
+
+TARGET_SSE2 static uint8_t minU8Sse2(const uint8_t* src, size_t n)
+{
+	__m128i m = _mm_set1_epi8(char(0xff));
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		m = _mm_min_epu8(m, _mm_loadu_si128((const __m128i*)(src + i)));
+	}
+	uint8_t lanes[16];
+	_mm_storeu_si128((__m128i*)lanes, m);
+	return Scalar<uint8_t>::min(src + i, n - i, Scalar<uint8_t>::min(lanes, 16, 0xff));
+}
+
+TARGET_SSE2 static uint8_t maxU8Sse2(const uint8_t* src, size_t n)
+{
+	__m128i m = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i*)(src + i)));
+	}
+	uint8_t lanes[16];
+	_mm_storeu_si128((__m128i*)lanes, m);
+	return Scalar<uint8_t>::max(src + i, n - i, Scalar<uint8_t>::max(lanes, 16, 0));
+}
+
+TARGET_SSE2 static void addU8Sse2(uint8_t* dst, const uint8_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(a, b));
+	}
+	Scalar<uint8_t>::add(dst + i, src + i, n - i);
+}
+
+/* AVX2 */
+
+TARGET_AVX2 static void fillF64Avx2(double* dst, double v, size_t n)
+{
+	__m256d x = _mm256_set1_pd(v);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		_mm256_storeu_pd(dst + i, x);
+	}
+	Scalar<double>::fill(dst + i, v, n - i);
+}
+
+TARGET_AVX2 static double sumF64Avx2(const double* src, size_t n)
+{
+	__m256d a = _mm256_setzero_pd(), b = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		a = _mm256_add_pd(a, _mm256_loadu_pd(src + i));
+		b = _mm256_add_pd(b, _mm256_loadu_pd(src + i + 4));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(a, b));
+	return Scalar<double>::sum(src + i, n - i, (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+}
+
+TARGET_AVX2 static double minF64Avx2(const double* src, size_t n)
+{
+	double init = std::numeric_limits<double>::infinity();
+	__m256d m = _mm256_set1_pd(init);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		m = _mm256_min_pd(_mm256_loadu_pd(src + i), m);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	return Scalar<double>::min(src + i, n - i, Scalar<double>::min(lanes, 4, init));
+}
+
+TARGET_AVX2 static double maxF64Avx2(const double* src, size_t n)
+{
+	double init = -std::numeric_limits<double>::infinity();
+	__m256d m = _mm256_set1_pd(init);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		m = _mm256_max_pd(_mm256_loadu_pd(src + i), m);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	return Scalar<double>::max(src + i, n - i, Scalar<double>::max(lanes, 4, init));
+}
+
+TARGET_AVX2 static void addF64Avx2(double* dst, const double* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i)));
+	}
+	Scalar<double>::add(dst + i, src + i, n - i);
+}
+
+TARGET_AVX2 static void mulF64Avx2(double* dst, const double* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		_mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i)));
+	}
+	Scalar<double>::mul(dst + i, src + i, n - i);
+}
+
+TARGET_AVX2 static void fillI32Avx2(int32_t* dst, int32_t v, size_t n)
+{
+	__m256i x = _mm256_set1_epi32(v);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		_mm256_storeu_si256((__m256i*)(dst + i), x);
+	}
+	Scalar<int32_t>::fill(dst + i, v, n - i);
+}
+
+TARGET_AVX2 static double sumI32Avx2(const int32_t* src, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(src + i))));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(src + i + 4))));
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	return double(Scalar<int32_t>::sum(src + i, n - i, lanes[0] + lanes[1] + lanes[2] + lanes[3]));
+}
+
+TARGET_AVX2 static int32_t minI32Avx2(const int32_t* src, size_t n)
+{
+	__m256i m = _mm256_set1_epi32(INT32_MAX);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i*)(src + i)));
+	}
+	int32_t lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	return Scalar<int32_t>::min(src + i, n - i, Scalar<int32_t>::min(lanes, 8, INT32_MAX));
+}
+
+TARGET_AVX2 static int32_t maxI32Avx2(const int32_t* src, size_t n)
+{
+	__m256i m = _mm256_set1_epi32(INT32_MIN);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		m = _mm256_max_epi32(m, _mm256_loadu_si256((const __m256i*)(src + i)));
+	}
+	int32_t lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	return Scalar<int32_t>::max(src + i, n - i, Scalar<int32_t>::max(lanes, 8, INT32_MIN));
+}
+
+TARGET_AVX2 static void addI32Avx2(int32_t* dst, const int32_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi32(a, b));
+	}
+	Scalar<int32_t>::add(dst + i, src + i, n - i);
+}
+
+TARGET_AVX2 static void mulI32Avx2(int32_t* dst, const int32_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_mullo_epi32(a, b));
+	}
+	Scalar<int32_t>::mul(dst + i, src + i, n - i);
+}
+
+TARGET_AVX2 static double sumU8Avx2(const uint8_t* src, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(src + i)), zero));
+	}
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	return double(Scalar<uint8_t>::sum(src + i, n - i, lanes[0] + lanes[1] + lanes[2] + lanes[3]));
+}
+
+TARGET_AVX2 static uint8_t minU8Avx2(const uint8_t* src, size_t n)
+{
+	__m256i m = _mm256_set1_epi8(char(0xff));
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		m = _mm256_min_epu8(m, _mm256_loadu_si256((const __m256i*)(src + i)));
+	}
+	uint8_t lanes[32];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	return Scalar<uint8_t>::min(src + i, n - i, Scalar<uint8_t>::min(lanes, 32, 0xff));
+}
+
+TARGET_AVX2 static uint8_t maxU8Avx2(const uint8_t* src, size_t n)
+{
+	__m256i m = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		m = _mm256_max_epu8(m, _mm256_loadu_si256((const __m256i*)(src + i)));
+	}
+	uint8_t lanes[32];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	return Scalar<uint8_t>::max(src + i, n - i, Scalar<uint8_t>::max(lanes, 32, 0));
+}
+
+TARGET_AVX2 static void addU8Avx2(uint8_t* dst, const uint8_t* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi8(a, b));
+	}
+	Scalar<uint8_t>::add(dst + i, src + i, n - i);
+}
+
+#undef TARGET_SSE2
+#undef TARGET_AVX2
+
+#define DISPATCH(avx2, sse2) \
+	switch (level()) { \
+		case AVX2: return avx2; \
+		case SSE2: return sse2; \
+		default: break; \
+	}
+#define DISPATCH_AVX2(avx2) \
+	if (level() == AVX2) { \
+		return avx2; \
+	}
+
+#else
+
+#define DISPATCH(avx2, sse2)
+#define DISPATCH_AVX2(avx2)
+
+#endif
+
+static Bulk::Level detect()
+{
+	Bulk::Level level = Bulk::Level::SCALAR;
+#ifdef BULK_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		level = Bulk::Level::AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		level = Bulk::Level::SSE2;
+	}
+#endif
+
+	const char* cap = getenv("CL_BULK");
+	if (cap && strcmp(cap, "scalar") == 0)
+	{
+		level = Bulk::Level::SCALAR;
+	}
+	else if (cap && strcmp(cap, "sse2") == 0)
+	{
+		level = std::min(level, Bulk::Level::SSE2);
+	}
+	return level;
+}
+
+static const Bulk::Level current = detect();
+
+Bulk::Level Bulk::level()
+{
+	return current;
+}
+
+void Bulk::fill(double* dst, double v, size_t n)
+{
+	DISPATCH(fillF64Avx2(dst, v, n), fillF64Sse2(dst, v, n))
+	Scalar<double>::fill(dst, v, n);
+}
+
+void Bulk::fill(int32_t* dst, int32_t v, size_t n)
+{
+	DISPATCH(fillI32Avx2(dst, v, n), fillI32Sse2(dst, v, n))
+	Scalar<int32_t>::fill(dst, v, n);
+}
+
+void Bulk::fill(uint8_t* dst, uint8_t v, size_t n)
+{
+	memset(dst, v, n);
+}
+
+double Bulk::sum(const double* src, size_t n)
+{
+	DISPATCH(sumF64Avx2(src, n), sumF64Sse2(src, n))
+	return Scalar<double>::sum(src, n);
+}
+
+double Bulk::sum(const int32_t* src, size_t n)
+{
+	DISPATCH(sumI32Avx2(src, n), sumI32Sse2(src, n))
+	return double(Scalar<int32_t>::sum(src, n));
+}
+
+double Bulk::sum(const uint8_t* src, size_t n)
+{
+	DISPATCH(sumU8Avx2(src, n), sumU8Sse2(src, n))
+	return double(Scalar<uint8_t>::sum(src, n));
+}
+
+double Bulk::min(const double* src, size_t n)
+{
+	DISPATCH(minF64Avx2(src, n), minF64Sse2(src, n))
+	return Scalar<double>::min(src, n, std::numeric_limits<double>::infinity());
+}
+
+double Bulk::min(const int32_t* src, size_t n)
+{
+	if (n == 0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	DISPATCH(minI32Avx2(src, n), minI32Sse2(src, n))
+	return Scalar<int32_t>::min(src, n, INT32_MAX);
+}
+
+double Bulk::min(const uint8_t* src, size_t n)
+{
+	if (n == 0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	DISPATCH(minU8Avx2(src, n), minU8Sse2(src, n))
+	return Scalar<uint8_t>::min(src, n, 0xff);
+}
+
+double Bulk::max(const double* src, size_t n)
+{
+	DISPATCH(maxF64Avx2(src, n), maxF64Sse2(src, n))
+	return Scalar<double>::max(src, n, -std::numeric_limits<double>::infinity());
+}
+
+double Bulk::max(const int32_t* src, size_t n)
+{
+	if (n == 0)
+	{
+		return -std::numeric_limits<double>::infinity();
+	}
+	DISPATCH(maxI32Avx2(src, n), maxI32Sse2(src, n))
+	return Scalar<int32_t>::max(src, n, INT32_MIN);
+}
+
+double Bulk::max(const uint8_t* src, size_t n)
+{
+	if (n == 0)
+	{
+		return -std::numeric_limits<double>::infinity();
+	}
+	DISPATCH(maxU8Avx2(src, n), maxU8Sse2(src, n))
+	return Scalar<uint8_t>::max(src, n, 0);
+}
+
+void Bulk::add(double* dst, const double* src, size_t n)
+{
+	DISPATCH(addF64Avx2(dst, src, n), addF64Sse2(dst, src, n))
+	Scalar<double>::add(dst, src, n);
+}
+
+void Bulk::add(int32_t* dst, const int32_t* src, size_t n)
+{
+	DISPATCH(addI32Avx2(dst, src, n), addI32Sse2(dst, src, n))
+	Scalar<int32_t>::add(dst, src, n);
+}
+
+void Bulk::add(uint8_t* dst, const uint8_t* src, size_t n)
+{
+	DISPATCH(addU8Avx2(dst, src, n), addU8Sse2(dst, src, n))
+	Scalar<uint8_t>::add(dst, src, n);
+}
+
+void Bulk::mul(double* dst, const double* src, size_t n)
+{
+	DISPATCH(mulF64Avx2(dst, src, n), mulF64Sse2(dst, src, n))
+	Scalar<double>::mul(dst, src, n);
+}
+
+void Bulk::mul(int32_t* dst, const int32_t* src, size_t n)
+{
+	DISPATCH_AVX2(mulI32Avx2(dst, src, n))
+	Scalar<int32_t>::mul(dst, src, n);
+}
+
+void Bulk::mul(uint8_t* dst, const uint8_t* src, size_t n)
+{
+	Scalar<uint8_t>::mul(dst, src, n);
+}
+
+NAMESPACE_END
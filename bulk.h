@@ -0,0 +1,54 @@
+#ifndef _BULK_H_
+#define _BULK_H_
+
+#include "common.h"
+
+NAMESPACE_BEGIN
+
+/*
+ * Bulk kernels over raw element storage. Each operation picks the widest
+ * instruction set the CPU reports at startup (AVX2, then SSE2) and falls
+ * back to scalar loops elsewhere. Integer arithmetic wraps like the
+ * element type; sums are returned as double. The level is fixed for the
+ * process; CL_BULK=scalar or CL_BULK=sse2 caps it, so the tests can run
+ * every kernel against the scalar loops.
+ */
+class Bulk {
+public:
+	enum Level {
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+
+	static Level level();
+
+	static void fill(double* dst, double v, size_t n);
+	static void fill(int32_t* dst, int32_t v, size_t n);
+	static void fill(uint8_t* dst, uint8_t v, size_t n);
+
+	static double sum(const double* src, size_t n);
+	static double sum(const int32_t* src, size_t n);
+	static double sum(const uint8_t* src, size_t n);
+
+	static double min(const double* src, size_t n);
+	static double min(const int32_t* src, size_t n);
+	static double min(const uint8_t* src, size_t n);
+
+	static double max(const double* src, size_t n);
+	static double max(const int32_t* src, size_t n);
+	static double max(const uint8_t* src, size_t n);
+
+	/* dst[i] = dst[i] op src[i] */
+	static void add(double* dst, const double* src, size_t n);
+	static void add(int32_t* dst, const int32_t* src, size_t n);
+	static void add(uint8_t* dst, const uint8_t* src, size_t n);
+
+	static void mul(double* dst, const double* src, size_t n);
+	static void mul(int32_t* dst, const int32_t* src, size_t n);
+	static void mul(uint8_t* dst, const uint8_t* src, size_t n);
+};
+
+NAMESPACE_END
+
+#endif
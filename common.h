@@ -14,6 +14,8 @@
 #include <sstream>
 #include <exception>
 #include <iostream>
+#include <cstdint>
+#include <cmath>
 
 NAMESPACE_BEGIN
 
@@ -0,0 +1,580 @@
+#include "heapsnapshot.h"
+#include "typedarray.h"
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+
+NAMESPACE_BEGIN
+
+/* A ValuePtr built from new keeps its count in a separate control block */
+static const size_t CONTROL_BLOCK = 3 * sizeof(void*);
+static const size_t NAME_LIMIT = 64;
+
+template<typename Map>
+static size_t mapSize(const Map& m)
+{
+	return m.bucket_count() * sizeof(void*)
+		+ m.size() * (sizeof(typename Map::value_type) + sizeof(void*));
+}
+
+static size_t stringSize(const std::string& s)
+{
+	return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+static std::string quote(const std::string& s)
+{
+	std::string ret = "\"";
+
+	for (unsigned char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			ret += '\\';
+			ret += c;
+		}
+		else if (c < 0x20)
+		{
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			ret += buf;
+		}
+		else
+		{
+			ret += c;
+		}
+	}
+	return ret + "\"";
+}
+
+/* The function owning the Env that code in layout sees as its innermost */
+static FrameLayout* envOwner(FrameLayout* layout)
+{
+	while (layout && layout->ncells_ == 0)
+	{
+		layout = layout->parent_;
+	}
+	return layout;
+}
+
+HeapSnapshot::HeapSnapshot(VM* vm)
+{
+	build(vm);
+	dominators();
+}
+
+uint32_t HeapSnapshot::node(Kind kind, const void* ptr, FrameLayout* layout)
+{
+	auto r = index_.find(ptr);
+	if (r != index_.end())
+	{
+		return r->second;
+	}
+
+	Node n;
+	n.kind_ = kind;
+	n.ptr_ = ptr;
+	n.layout_ = layout;
+	n.type_ = "synthetic";
+	n.self_ = 0;
+	n.retained_ = 0;
+	n.firstEdge_ = 0;
+	n.edgeCount_ = 0;
+	n.dominator_ = 0;
+	n.via_ = UINT32_MAX;
+
+	uint32_t id = nodes_.size();
+	index_[ptr] = id;
+	nodes_.push_back(n);
+	return id;
+}
+
+void HeapSnapshot::edge(Edge::Type type, const std::string& name, uint32_t index, uint32_t to)
+{
+	Edge e;
+	e.type_ = type;
+	e.name_ = name;
+	e.index_ = index;
+	e.to_ = to;
+
+	if (nodes_[to].via_ == UINT32_MAX)
+	{
+		nodes_[to].via_ = edges_.size();
+	}
+	edges_.push_back(e);
+}
+
+void HeapSnapshot::link(Edge::Type type, const std::string& name, const ValuePtr& v)
+{
+	if (v)
+	{
+		edge(type, name, 0, node(VALUE, v.get()));
+	}
+}
+
+void HeapSnapshot::link(uint32_t index, const ValuePtr& v)
+{
+	if (v)
+	{
+		edge(Edge::Type::ELEMENT, "", index, node(VALUE, v.get()));
+	}
+}
+
+void HeapSnapshot::link(const std::string& name, const EnvPtr& env, FrameLayout* layout)
+{
+	if (env)
+	{
+		edge(Edge::Type::CONTEXT, name, 0, node(ENV, env.get(), layout));
+	}
+}
+
+/* Edges to a frame's slots or an Env's cells, named by the variables they hold */
+void HeapSnapshot::linkLocals(FrameLayout* layout, bool captured, const std::vector<ValuePtr>& values)
+{
+	std::vector<std::string> names(values.size());
+
+	if (layout)
+	{
+		for (auto& l : layout->locals_)
+		{
+			size_t i = layout->index_[l.second];
+			if (layout->captured_[l.second] == captured && i < names.size())
+			{
+				names[i] = atomName(l.first);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		link(Edge::Type::CONTEXT, names[i].empty() ? std::to_string(i) : names[i], values[i]);
+	}
+}
+
+void HeapSnapshot::build(VM* vm)
+{
+	uint32_t root = node(ROOT, NULL);
+	nodes_[root].name_ = "(roots)";
+
+	if (vm->global_)
+	{
+		edge(Edge::Type::INTERNAL, "global", 0, node(SCOPE, vm->global_));
+	}
+
+	/* Innermost first: frame0 is the running function */
+	uint32_t depth = 0;
+	for (Frame* f = vm->frame_; f; f = f->caller_)
+	{
+		edge(Edge::Type::INTERNAL, "frame" + std::to_string(depth++), 0, node(FRAME, f));
+	}
+
+	if (vm->consts_)
+	{
+		for (size_t i = 0; i < vm->consts_->size(); ++i)
+		{
+			link(Edge::Type::INTERNAL, "const " + std::to_string(i), (*vm->consts_)[i]);
+		}
+	}
+
+	ValuePtr* protos = vm->isolate_.protos_;
+	link(Edge::Type::INTERNAL, "Boolean.prototype", protos[Value::Type::BOOL]);
+	link(Edge::Type::INTERNAL, "Number.prototype", protos[Value::Type::NUMBER]);
+	link(Edge::Type::INTERNAL, "String.prototype", protos[Value::Type::STRING]);
+	link(Edge::Type::INTERNAL, "TypedArray.prototype", vm->isolate_.typedProto_);
+
+	nodes_[root].edgeCount_ = edges_.size();
+
+	/* Breadth first, so each node's edges are contiguous and via_ is a shortest path */
+	for (uint32_t n = 1; n < nodes_.size(); ++n)
+	{
+		nodes_[n].firstEdge_ = edges_.size();
+		expand(n);
+		nodes_[n].edgeCount_ = edges_.size() - nodes_[n].firstEdge_;
+	}
+}
+
+void HeapSnapshot::expand(uint32_t n)
+{
+	Kind kind = nodes_[n].kind_;
+
+	if (kind == SCOPE)
+	{
+		Scope* s = (Scope*)nodes_[n].ptr_;
+		nodes_[n].name_ = "(scope)";
+		nodes_[n].self_ = sizeof(Scope) + mapSize(s->getValueMap());
+
+		for (auto& v : s->getValueMap())
+		{
+			link(Edge::Type::PROPERTY, atomName(v.first), v.second);
+		}
+		if (s->getParent())
+		{
+			edge(Edge::Type::INTERNAL, "parent", 0, node(SCOPE, s->getParent()));
+		}
+	}
+	else if (kind == FRAME)
+	{
+		Frame* f = (Frame*)nodes_[n].ptr_;
+		FrameLayout* layout = f->func_ ? f->func_->layout_ : NULL;
+		nodes_[n].name_ = "(frame) " + (f->func_ ? functionName(f->func_) : std::string("(program)"));
+		nodes_[n].self_ = f->slots_.capacity() * sizeof(ValuePtr);
+
+		linkLocals(layout, false, f->slots_);
+		link(Edge::Type::INTERNAL, "this", f->this_);
+		link(Edge::Type::INTERNAL, "arguments", f->arguments_);
+		link("context", f->env_, envOwner(layout));
+	}
+	else if (kind == ENV)
+	{
+		Env* e = (Env*)nodes_[n].ptr_;
+		FrameLayout* layout = nodes_[n].layout_;
+		nodes_[n].type_ = "object";
+		nodes_[n].name_ = "system / Context";
+		nodes_[n].self_ = sizeof(Env) + CONTROL_BLOCK + e->cells_.capacity() * sizeof(ValuePtr);
+
+		linkLocals(layout, true, e->cells_);
+		link("previous", e->parent_, layout ? envOwner(layout->parent_) : NULL);
+	}
+	else if (kind == VALUE)
+	{
+		describe(nodes_[n], (Value*)nodes_[n].ptr_);
+	}
+}
+
+/* Fills in the node for one value and adds the edges to what it references */
+void HeapSnapshot::describe(Node& n, Value* v)
+{
+	size_t self = CONTROL_BLOCK;
+	uint32_t id = &n - &nodes_[0];
+
+	if (StringValue* s = dynamic_cast<StringValue*>(v))
+	{
+		self += sizeof(StringValue) + stringSize(s->str_);
+		if (s->right_)
+		{
+			n.type_ = "concatenated string";
+			n.name_ = "(concatenated string)";
+		}
+		else if (s->left_)
+		{
+			n.type_ = "sliced string";
+			n.name_ = "(sliced string)";
+		}
+		else
+		{
+			n.type_ = "string";
+			n.name_ = s->str_.substr(0, NAME_LIMIT);
+		}
+		nodes_[id].self_ = self;
+		link(Edge::Type::INTERNAL, "first", s->left_);
+		link(Edge::Type::INTERNAL, "second", s->right_);
+		return;
+	}
+
+	ObjectLike* obj = dynamic_cast<ObjectLike*>(v);
+	if (obj == NULL)
+	{
+		n.type_ = v->type_ == Value::Type::NUMBER ? "number" : "hidden";
+		n.name_ = v->type_ == Value::Type::SIGNAL ? "(signal)" : v->toString();
+		n.self_ = self + (v->type_ == Value::Type::NUMBER ? sizeof(Number) : sizeof(Value));
+		return;
+	}
+
+	self += mapSize(obj->attr_) + mapSize(obj->named_);
+	n.type_ = "object";
+
+	if (ArrayValue* a = dynamic_cast<ArrayValue*>(v))
+	{
+		n.name_ = "Array";
+		self += sizeof(ArrayValue) + a->elems_.capacity() * sizeof(ValuePtr);
+		nodes_[id].self_ = self;
+
+		for (size_t i = 0; i < a->elems_.size(); ++i)
+		{
+			link(i, a->elems_[i]);
+		}
+	}
+	else if (FunctionValue* f = dynamic_cast<FunctionValue*>(v))
+	{
+		n.type_ = "closure";
+		n.name_ = functionName(f->code_);
+		n.self_ = self + sizeof(FunctionValue);
+		link("context", f->env_, envOwner(f->code_->layout_ ? f->code_->layout_->parent_ : NULL));
+	}
+	else if (NativeFunction* f = dynamic_cast<NativeFunction*>(v))
+	{
+		n.type_ = "closure";
+		n.name_ = f->name_;
+		n.self_ = self + sizeof(NativeFunction) + stringSize(f->name_);
+	}
+	else if (TypedArrayValue* t = dynamic_cast<TypedArrayValue*>(v))
+	{
+		n.name_ = TypedArrayValue::kindName(t->kind_);
+		n.self_ = self + sizeof(TypedArrayValue);
+		link(Edge::Type::INTERNAL, "buffer", t->buffer_);
+	}
+	else if (ArrayBufferValue* b = dynamic_cast<ArrayBufferValue*>(v))
+	{
+		n.name_ = "ArrayBuffer";
+		n.self_ = self + sizeof(ArrayBufferValue) + b->data_.capacity();
+	}
+	else
+	{
+		n.name_ = "Object";
+		n.self_ = self + sizeof(ObjectValue);
+	}
+
+	for (auto& p : obj->attr_)
+	{
+		link(Edge::Type::PROPERTY, atomName(p.first), p.second);
+	}
+	for (auto& p : obj->named_)
+	{
+		link(Edge::Type::PROPERTY, p.first.name_, p.second);
+	}
+}
+
+void HeapSnapshot::dominators()
+{
+	size_t count = nodes_.size();
+	std::vector<std::vector<uint32_t>> preds(count);
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> rank(count, UINT32_MAX);
+	std::vector<uint32_t> next(count, 0);
+	std::vector<uint32_t> stack;
+
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		for (uint32_t e = 0; e < nodes_[n].edgeCount_; ++e)
+		{
+			preds[edges_[nodes_[n].firstEdge_ + e].to_].push_back(n);
+		}
+	}
+
+	/* Postorder numbering by an explicit depth first walk */
+	stack.push_back(0);
+	rank[0] = 0;
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		if (next[n] < nodes_[n].edgeCount_)
+		{
+			uint32_t to = edges_[nodes_[n].firstEdge_ + next[n]++].to_;
+			if (rank[to] == UINT32_MAX)
+			{
+				rank[to] = 0;
+				stack.push_back(to);
+			}
+			continue;
+		}
+		rank[n] = order.size();
+		order.push_back(n);
+		stack.pop_back();
+	}
+
+	std::vector<uint32_t> idom(count, UINT32_MAX);
+	idom[0] = 0;
+
+	auto intersect = [&](uint32_t a, uint32_t b) {
+		while (a != b)
+		{
+			while (rank[a] < rank[b])
+			{
+				a = idom[a];
+			}
+			while (rank[b] < rank[a])
+			{
+				b = idom[b];
+			}
+		}
+		return a;
+	};
+
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t i = order.size() - 1; i-- > 0; )
+		{
+			uint32_t n = order[i];
+			uint32_t dom = UINT32_MAX;
+
+			for (uint32_t p : preds[n])
+			{
+				if (idom[p] != UINT32_MAX)
+				{
+					dom = dom == UINT32_MAX ? p : intersect(p, dom);
+				}
+			}
+			if (dom != idom[n])
+			{
+				idom[n] = dom;
+				changed = true;
+			}
+		}
+	}
+
+	/* Children come before their dominator in postorder */
+	for (uint32_t n : order)
+	{
+		nodes_[n].dominator_ = idom[n];
+		nodes_[n].retained_ += nodes_[n].self_;
+		if (n != 0)
+		{
+			nodes_[idom[n]].retained_ += nodes_[n].retained_;
+		}
+	}
+}
+
+size_t HeapSnapshot::retainedSize(const ValuePtr& v)
+{
+	auto r = index_.find(v.get());
+	return r == index_.end() ? 0 : nodes_[r->second].retained_;
+}
+
+std::string HeapSnapshot::path(uint32_t n)
+{
+	std::vector<const Edge*> steps;
+
+	while (n != 0 && nodes_[n].via_ != UINT32_MAX)
+	{
+		const Edge* e = &edges_[nodes_[n].via_];
+		steps.push_back(e);
+
+		/* The edge's owner is the node whose range contains it */
+		uint32_t from = 0;
+		for (uint32_t lo = 0, hi = nodes_.size(); lo < hi; )
+		{
+			uint32_t mid = (lo + hi) / 2;
+			if (nodes_[mid].firstEdge_ <= nodes_[n].via_ && nodes_[mid].edgeCount_ + nodes_[mid].firstEdge_ > nodes_[n].via_)
+			{
+				from = mid;
+				break;
+			}
+			if (nodes_[mid].firstEdge_ + nodes_[mid].edgeCount_ <= nodes_[n].via_)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		n = from;
+	}
+
+	std::string ret;
+	for (auto i = steps.rbegin(); i != steps.rend(); ++i)
+	{
+		const Edge* e = *i;
+		if (e->type_ == Edge::Type::ELEMENT)
+		{
+			ret += "[" + std::to_string(e->index_) + "]";
+		}
+		else
+		{
+			ret += (ret.empty() ? "" : ".") + e->name_;
+		}
+	}
+	return ret;
+}
+
+void HeapSnapshot::write(std::ostream& out)
+{
+	static const char* const NODE_TYPES[] = {
+		"hidden", "array", "string", "object", "code", "closure", "regexp", "number",
+		"native", "synthetic", "concatenated string", "sliced string"
+	};
+	static const char* const EDGE_TYPES[] = {
+		"context", "element", "property", "internal"
+	};
+	const size_t NODE_FIELDS = 6;
+
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, uint32_t> ids;
+	auto string = [&](const std::string& s) {
+		auto r = ids.find(s);
+		if (r != ids.end())
+		{
+			return r->second;
+		}
+		ids[s] = strings.size();
+		strings.push_back(s);
+		return uint32_t(strings.size() - 1);
+	};
+
+	out << "{\"snapshot\":{\"meta\":{"
+		<< "\"node_fields\":[\"type\",\"name\",\"id\",\"self_size\",\"edge_count\",\"trace_node_id\"],"
+		<< "\"node_types\":[[";
+	for (size_t i = 0; i < sizeof(NODE_TYPES) / sizeof(NODE_TYPES[0]); ++i)
+	{
+		out << (i ? "," : "") << quote(NODE_TYPES[i]);
+	}
+	out << "],\"string\",\"number\",\"number\",\"number\",\"number\",\"number\"],"
+		<< "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],"
+		<< "\"edge_types\":[[";
+	for (size_t i = 0; i < sizeof(EDGE_TYPES) / sizeof(EDGE_TYPES[0]); ++i)
+	{
+		out << (i ? "," : "") << quote(EDGE_TYPES[i]);
+	}
+	out << "],\"string_or_number\",\"node\"],"
+		<< "\"trace_function_info_fields\":[],\"trace_node_fields\":[],"
+		<< "\"sample_fields\":[],\"location_fields\":[]},"
+		<< "\"node_count\":" << nodes_.size() << ",\"edge_count\":" << edges_.size()
+		<< ",\"trace_function_count\":0},\n\"nodes\":[";
+
+	for (size_t i = 0; i < nodes_.size(); ++i)
+	{
+		const Node& n = nodes_[i];
+		size_t type = 0;
+		while (type < sizeof(NODE_TYPES) / sizeof(NODE_TYPES[0]) && strcmp(NODE_TYPES[type], n.type_) != 0)
+		{
+			type++;
+		}
+		out << (i ? ",\n" : "") << type << "," << string(n.name_) << "," << i * 2 + 1
+			<< "," << n.self_ << "," << n.edgeCount_ << ",0";
+	}
+
+	out << "],\n\"edges\":[";
+	for (size_t i = 0; i < edges_.size(); ++i)
+	{
+		const Edge& e = edges_[i];
+		out << (i ? ",\n" : "") << int(e.type_) << ","
+			<< (e.type_ == Edge::Type::ELEMENT ? e.index_ : string(e.name_))
+			<< "," << e.to_ * NODE_FIELDS;
+	}
+
+	out << "],\n\"trace_function_infos\":[],\"trace_tree\":[],\"samples\":[],\"locations\":[],\n\"strings\":[";
+	for (size_t i = 0; i < strings.size(); ++i)
+	{
+		out << (i ? ",\n" : "") << quote(strings[i]);
+	}
+	out << "]}\n";
+}
+
+void HeapSnapshot::writeSummary(std::ostream& out, size_t top)
+{
+	std::vector<uint32_t> rows;
+	for (uint32_t i = 1; i < nodes_.size(); ++i)
+	{
+		rows.push_back(i);
+	}
+	std::sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+		return nodes_[a].retained_ > nodes_[b].retained_;
+	});
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%zu nodes, %zu edges, %zu bytes\n%12s %10s  %-20s %s\n",
+		nodes_.size(), edges_.size(), totalSize(), "retained", "self", "node", "path");
+	out << buf;
+
+	for (size_t i = 0; i < rows.size() && i < top; ++i)
+	{
+		const Node& n = nodes_[rows[i]];
+		std::string name = n.name_.substr(0, 20);
+		snprintf(buf, sizeof(buf), "%12zu %10zu  %-20s ", n.retained_, n.self_, name.c_str());
+		out << buf << path(rows[i]) << "\n";
+	}
+}
+
+NAMESPACE_END
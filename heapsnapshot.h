@@ -0,0 +1,95 @@
+#ifndef _HEAPSNAPSHOT_H_
+#define _HEAPSNAPSHOT_H_
+
+#include "vm.h"
+
+NAMESPACE_BEGIN
+
+/*
+ * The object graph reachable from a VM's roots: the global scope, the
+ * live frames, the program constants and the primitive prototypes. Every
+ * value, captured-variable Env, scope and frame becomes a node with an
+ * estimate of the bytes it holds itself; edges carry property names,
+ * element indices or variable names.
+ *
+ * Retained sizes come from the dominator tree (Cooper, Harvey and
+ * Kennedy's iterative algorithm): a node retains everything that would
+ * become unreachable without it.
+ */
+class HeapSnapshot {
+public:
+	enum Kind {
+		ROOT,
+		SCOPE,
+		FRAME,
+		ENV,
+		VALUE
+	};
+
+	struct Edge {
+		enum Type {
+			CONTEXT,
+			ELEMENT,
+			PROPERTY,
+			INTERNAL
+		};
+
+		Type type_;
+		std::string name_;
+		uint32_t index_;
+		uint32_t to_;
+	};
+
+	struct Node {
+		Kind kind_;
+		const void* ptr_;
+		FrameLayout* layout_;
+		const char* type_;
+		std::string name_;
+		size_t self_;
+		size_t retained_;
+		uint32_t firstEdge_;
+		uint32_t edgeCount_;
+		uint32_t dominator_;
+		/* The first edge that reached this node, for shortest retaining paths */
+		uint32_t via_;
+	};
+
+private:
+	std::vector<Node> nodes_;
+	std::vector<Edge> edges_;
+	std::unordered_map<const void*, uint32_t> index_;
+
+	uint32_t node(Kind kind, const void* ptr, FrameLayout* layout = NULL);
+	void edge(Edge::Type type, const std::string& name, uint32_t index, uint32_t to);
+	void link(Edge::Type type, const std::string& name, const ValuePtr& v);
+	void link(uint32_t index, const ValuePtr& v);
+	void link(const std::string& name, const EnvPtr& env, FrameLayout* layout);
+	void linkLocals(FrameLayout* layout, bool captured, const std::vector<ValuePtr>& values);
+
+	void build(VM* vm);
+	void expand(uint32_t n);
+	void describe(Node& n, Value* v);
+	void dominators();
+
+	std::string path(uint32_t n);
+
+public:
+	HeapSnapshot(VM* vm);
+
+	inline const std::vector<Node>& nodes() { return nodes_; }
+	inline const std::vector<Edge>& edges() { return edges_; }
+
+	inline size_t totalSize() { return nodes_.empty() ? 0 : nodes_[0].retained_; }
+	/* Bytes that would be freed if v became unreachable; 0 if not in the graph */
+	size_t retainedSize(const ValuePtr& v);
+
+	/* Chrome DevTools .heapsnapshot JSON */
+	void write(std::ostream& out);
+	/* The nodes retaining the most, with a shortest path from the roots */
+	void writeSummary(std::ostream& out, size_t top = 30);
+};
+
+NAMESPACE_END
+
+#endif
@@ -0,0 +1,769 @@
+#include "vm.h"
+
+NAMESPACE_BEGIN
+
+static const Atom LENGTH = atom("length");
+
+enum {
+	REG_VAR,
+	REG_CONST,
+	REG_TEMP
+};
+
+static bool traceCode(BiExpression::Op op, TraceOp::Code& code)
+{
+	switch (op)
+	{
+		case BiExpression::Op::PLUS: code = TraceOp::Code::ADD; return true;
+		case BiExpression::Op::MINUS: code = TraceOp::Code::SUB; return true;
+		case BiExpression::Op::MUL: code = TraceOp::Code::MUL; return true;
+		case BiExpression::Op::DIV: code = TraceOp::Code::DIV; return true;
+		case BiExpression::Op::MOD: code = TraceOp::Code::MOD; return true;
+		case BiExpression::Op::BAND: code = TraceOp::Code::BAND; return true;
+		case BiExpression::Op::BOR: code = TraceOp::Code::BOR; return true;
+		case BiExpression::Op::BXOR: code = TraceOp::Code::BXOR; return true;
+		case BiExpression::Op::LSHIFT: code = TraceOp::Code::SHL; return true;
+		case BiExpression::Op::RSHIFT: code = TraceOp::Code::SHR; return true;
+		case BiExpression::Op::LS: code = TraceOp::Code::LT; return true;
+		case BiExpression::Op::LE: code = TraceOp::Code::LE; return true;
+		case BiExpression::Op::GT: code = TraceOp::Code::GT; return true;
+		case BiExpression::Op::GE: code = TraceOp::Code::GE; return true;
+		case BiExpression::Op::EQ: code = TraceOp::Code::EQ; return true;
+		case BiExpression::Op::NEQ: code = TraceOp::Code::NE; return true;
+		case BiExpression::Op::TEQ: code = TraceOp::Code::EQ; return true;
+		case BiExpression::Op::NTEQ: code = TraceOp::Code::NE; return true;
+		default: return false;
+	}
+}
+
+bool LoopTrace::enter(Frame* frame)
+{
+	size_t n = vars_.size();
+
+	regs_.resize(nregs_);
+	snapshot_.resize(n);
+	cells_.resize(n);
+	arrays_.assign(n, NULL);
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		TraceVar& v = vars_[i];
+
+		for (auto s : v.scopes_)
+		{
+			if (s->owner(v.name_) != v.owner_)
+			{
+				return false;
+			}
+		}
+
+		ValuePtr& cell = v.owner_ ? v.owner_->getValueMap()[v.name_] : frame->local(v.local_);
+
+		if (v.type_ == Value::Type::NUMBER)
+		{
+			auto num = CAST(Number, cell);
+			if (num == nullptr)
+			{
+				return false;
+			}
+			regs_[i] = num->num_;
+		}
+		else if (v.type_ == Value::Type::ARRAY)
+		{
+			if (!cell || cell->type_ != Value::Type::ARRAY)
+			{
+				return false;
+			}
+			arrays_[i] = static_cast<ArrayValue*>(cell.get());
+			regs_[i] = 0.0;
+		}
+		else
+		{
+			auto b = CAST(Boolean, cell);
+			if (b == nullptr)
+			{
+				return false;
+			}
+			regs_[i] = b->b_ ? 1.0 : 0.0;
+		}
+
+		cells_[i] = &cell;
+	}
+
+	std::copy(consts_.begin(), consts_.end(), regs_.begin() + n);
+
+	return true;
+}
+
+void LoopTrace::leave()
+{
+	for (size_t i = 0; i < vars_.size(); ++i)
+	{
+		if (!vars_[i].written_)
+		{
+			continue;
+		}
+
+		if (vars_[i].type_ == Value::Type::NUMBER)
+		{
+			*cells_[i] = std::isnan(regs_[i]) ? NotaNumber::instance() : ValuePtr(new Number(regs_[i]));
+		}
+		else
+		{
+			*cells_[i] = ValuePtr(new Boolean(regs_[i] != 0.0));
+		}
+	}
+}
+
+#define TRACE_OP(code) case TraceOp::Code::code: \
+	r[op->dst_] = TraceOp::eval(TraceOp::Code::code, r[op->a_], r[op->b_]); \
+	break;
+
+LoopTrace::Result LoopTrace::run(Frame* frame, ExecBudget& budget)
+{
+	if (!enter(frame))
+	{
+		return Result::NOT_ENTERED;
+	}
+
+	size_t nvars = vars_.size();
+	double* r = regs_.data();
+	double* snap = snapshot_.data();
+	const TraceOp* begin = ops_.data();
+	const TraceOp* end = begin + ops_.size();
+
+	for (;;)
+	{
+		if (budget.tick())
+		{
+			leave();
+			return Result::PREEMPTED;
+		}
+
+		std::copy(r, r + nvars, snap);
+
+		for (const TraceOp* op = begin; op != end; ++op)
+		{
+			switch (op->code_)
+			{
+				TRACE_OP(MOV)
+				TRACE_OP(ADD)
+				TRACE_OP(SUB)
+				TRACE_OP(MUL)
+				TRACE_OP(DIV)
+				TRACE_OP(MOD)
+				TRACE_OP(BAND)
+				TRACE_OP(BOR)
+				TRACE_OP(BXOR)
+				TRACE_OP(SHL)
+				TRACE_OP(SHR)
+				TRACE_OP(NEG)
+				TRACE_OP(BNOT)
+				TRACE_OP(LT)
+				TRACE_OP(LE)
+				TRACE_OP(GT)
+				TRACE_OP(GE)
+				TRACE_OP(EQ)
+				TRACE_OP(NE)
+				TRACE_OP(NOT)
+				TRACE_OP(TRUTH)
+
+				case TraceOp::Code::ELEM:
+				{
+					double d = r[op->a_];
+					if (!(d >= 0.0 && d < 4294967296.0) || double(uint32_t(d)) != d)
+					{
+						goto side_exit;
+					}
+					Value* v = arrays_[op->b_]->dense(uint32_t(d));
+					if (v == NULL || v->type_ != Value::Type::NUMBER)
+					{
+						goto side_exit;
+					}
+					r[op->dst_] = v->toNumber();
+					break;
+				}
+
+				case TraceOp::Code::LENGTH:
+					r[op->dst_] = arrays_[op->a_]->length();
+					break;
+
+				case TraceOp::Code::GUARD_TRUE:
+					if (!TraceOp::truthy(r[op->a_]))
+					{
+						goto side_exit;
+					}
+					break;
+
+				case TraceOp::Code::GUARD_FALSE:
+					if (TraceOp::truthy(r[op->a_]))
+					{
+						goto side_exit;
+					}
+					break;
+
+				case TraceOp::Code::GUARD_NONZERO:
+					if (!TraceOp::truthy(r[op->a_]))
+					{
+						goto side_exit;
+					}
+					break;
+
+				case TraceOp::Code::EXIT_UNLESS:
+					if (!TraceOp::truthy(r[op->a_]))
+					{
+						leave();
+						return Result::LOOP_DONE;
+					}
+					break;
+
+				case TraceOp::Code::EXIT:
+					leave();
+					return Result::LOOP_DONE;
+			}
+		}
+	}
+
+	side_exit:
+	{
+		std::copy(snap, snap + nvars, r);
+		leave();
+		return Result::SIDE_EXIT;
+	}
+}
+
+#undef TRACE_OP
+
+TraceRecorder::TraceRecorder(VM* vm):
+	vm_(vm), trace_(new LoopTrace()), flow_(RUN)
+{}
+
+TraceRecorder::~TraceRecorder()
+{
+	deletePtr(trace_);
+}
+
+LoopTrace* TraceRecorder::release()
+{
+	LoopTrace* ret = trace_;
+	trace_ = NULL;
+	return ret;
+}
+
+int TraceRecorder::newReg(int kind, Value::Type type, double val)
+{
+	kinds_.push_back(kind);
+	types_.push_back(type);
+	vals_.push_back(val);
+	arrays_.push_back(NULL);
+	return vals_.size() - 1;
+}
+
+int TraceRecorder::var(Identifier* id)
+{
+	Scope* scope = id->scope_;
+	Scope* owner = NULL;
+
+	if (id->binding_ == Identifier::Binding::GLOBAL)
+	{
+		owner = scope->owner(id->atom_);
+		if (owner == NULL)
+		{
+			throw Abort();
+		}
+	}
+
+	for (size_t i = 0; i < vars_.size(); ++i)
+	{
+		TraceVar& v = trace_->vars_[i];
+		if (v.same(id, owner))
+		{
+			if (owner && std::find(v.scopes_.begin(), v.scopes_.end(), scope) == v.scopes_.end())
+			{
+				v.scopes_.push_back(scope);
+			}
+			return vars_[i];
+		}
+	}
+
+	ValuePtr val = owner ? owner->getValueMap()[id->atom_] : vm_->frame_->local(id);
+	Value::Type type;
+	double d;
+
+	if (CAST(Number, val))
+	{
+		type = Value::Type::NUMBER;
+		d = CAST(Number, val)->num_;
+	}
+	else if (CAST(Boolean, val))
+	{
+		type = Value::Type::BOOL;
+		d = CAST(Boolean, val)->b_ ? 1.0 : 0.0;
+	}
+	else if (val && val->type_ == Value::Type::ARRAY)
+	{
+		type = Value::Type::ARRAY;
+		d = 0.0;
+	}
+	else
+	{
+		throw Abort();
+	}
+
+	trace_->vars_.push_back(TraceVar(id, owner, type));
+	if (owner)
+	{
+		trace_->vars_.back().scopes_.push_back(scope);
+	}
+
+	int reg = newReg(REG_VAR, type, d);
+	vars_.push_back(reg);
+	if (type == Value::Type::ARRAY)
+	{
+		arrays_[reg] = static_cast<ArrayValue*>(val.get());
+	}
+
+	return reg;
+}
+
+int TraceRecorder::constant(Value::Type type, double val)
+{
+	for (auto c : consts_)
+	{
+		if (types_[c] == type && vals_[c] == val)
+		{
+			return c;
+		}
+	}
+
+	int reg = newReg(REG_CONST, type, val);
+	consts_.push_back(reg);
+
+	return reg;
+}
+
+int TraceRecorder::temp(Value::Type type)
+{
+	return newReg(REG_TEMP, type, 0.0);
+}
+
+int TraceRecorder::emit(TraceOp::Code code, Value::Type type, int a, int b)
+{
+	int dst = temp(type);
+	vals_[dst] = TraceOp::eval(code, vals_[a], vals_[b]);
+	trace_->ops_.push_back(TraceOp(code, dst, a, b));
+	return dst;
+}
+
+bool TraceRecorder::truth(int reg)
+{
+	return TraceOp::truthy(vals_[reg]);
+}
+
+bool TraceRecorder::guard(int reg)
+{
+	bool t = truth(reg);
+	trace_->ops_.push_back(TraceOp(t ? TraceOp::Code::GUARD_TRUE
+		: TraceOp::Code::GUARD_FALSE, -1, reg, reg));
+	return t;
+}
+
+int TraceRecorder::num(int reg)
+{
+	if (types_[reg] != Value::Type::NUMBER)
+	{
+		throw Abort();
+	}
+	return reg;
+}
+
+int TraceRecorder::array(AST* base)
+{
+	if (base->type_ != AST::Type::IDENTIFIER)
+	{
+		throw Abort();
+	}
+
+	int reg = var(dynamic_cast<Identifier*>(base));
+	if (types_[reg] != Value::Type::ARRAY)
+	{
+		throw Abort();
+	}
+	return reg;
+}
+
+void TraceRecorder::store(Identifier* id, int reg)
+{
+	int v = var(id);
+
+	if (types_[v] != types_[reg])
+	{
+		throw Abort();
+	}
+
+	trace_->ops_.push_back(TraceOp(TraceOp::Code::MOV, v, reg, reg));
+	vals_[v] = vals_[reg];
+
+	for (size_t i = 0; i < vars_.size(); ++i)
+	{
+		if (vars_[i] == v)
+		{
+			trace_->vars_[i].written_ = true;
+		}
+	}
+}
+
+int TraceRecorder::assign(AST* left, int reg)
+{
+	if (left->type_ != AST::Type::IDENTIFIER)
+	{
+		throw Abort();
+	}
+
+	store(dynamic_cast<Identifier*>(left), reg);
+
+	return reg;
+}
+
+int TraceRecorder::binary(BiExpression* bi)
+{
+	if (bi->opcode_ == BiExpression::Op::AND
+		|| bi->opcode_ == BiExpression::Op::OR)
+	{
+		bool t = guard(expr(bi->left_));
+		if (t == (bi->opcode_ == BiExpression::Op::OR))
+		{
+			return constant(Value::Type::BOOL, t ? 1.0 : 0.0);
+		}
+		int r = expr(bi->right_);
+		return emit(TraceOp::Code::TRUTH, Value::Type::BOOL, r, r);
+	}
+
+	int rval = expr(bi->right_);
+
+	if (bi->opcode_ == BiExpression::Op::ASSIGN)
+	{
+		return assign(bi->left_, rval);
+	}
+
+	int lval = expr(bi->left_);
+
+	if (bi->opcode_ == BiExpression::Op::REV)
+	{
+		return assign(bi->left_, emit(TraceOp::Code::BNOT,
+			Value::Type::NUMBER, num(rval), rval));
+	}
+
+	TraceOp::Code code;
+
+	if (!traceCode(bi->opcode_, code))
+	{
+		throw Abort();
+	}
+
+	Value::Type type = code >= TraceOp::Code::LT ?
+		Value::Type::BOOL : Value::Type::NUMBER;
+
+	if (code == TraceOp::Code::MOD)
+	{
+		trace_->ops_.push_back(TraceOp(TraceOp::Code::GUARD_NONZERO, -1,
+			num(rval), rval));
+	}
+
+	int ret = emit(code, type, num(lval), num(rval));
+
+	if (bi->compound_)
+	{
+		return assign(bi->left_, ret);
+	}
+
+	return ret;
+}
+
+int TraceRecorder::unary(UniExpression* u)
+{
+	if (u->op_ == "++" || u->op_ == "--")
+	{
+		if (u->expr_->type_ != AST::Type::IDENTIFIER)
+		{
+			throw Abort();
+		}
+
+		auto id = dynamic_cast<Identifier*>(u->expr_);
+		int v = num(var(id));
+		int one = constant(Value::Type::NUMBER, 1.0);
+		TraceOp::Code code = u->op_ == "++" ?
+			TraceOp::Code::ADD : TraceOp::Code::SUB;
+
+		if (u->pre_)
+		{
+			int ret = emit(code, Value::Type::NUMBER, v, one);
+			store(id, ret);
+			return ret;
+		}
+
+		int old = emit(TraceOp::Code::MOV, Value::Type::NUMBER, v, v);
+		store(id, emit(code, Value::Type::NUMBER, v, one));
+		return old;
+	}
+
+	if (!u->pre_)
+	{
+		throw Abort();
+	}
+
+	if (u->op_ == "+")
+	{
+		return expr(u->expr_);
+	}
+
+	int r = expr(u->expr_);
+
+	if (u->op_ == "-")
+	{
+		return emit(TraceOp::Code::NEG, Value::Type::NUMBER, num(r), r);
+	}
+
+	if (u->op_ == "~")
+	{
+		return emit(TraceOp::Code::BNOT, Value::Type::NUMBER, num(r), r);
+	}
+
+	if (u->op_ == "!")
+	{
+		return emit(TraceOp::Code::NOT, Value::Type::BOOL, r, r);
+	}
+
+	throw Abort();
+}
+
+/* Only loads that hit a numeric element while recording are traced */
+int TraceRecorder::element(ArrayMember* m)
+{
+	int i = num(expr(m->attr_));
+	int a = array(m->base_);
+	double d = vals_[i];
+	Value* v = NULL;
+
+	if (d >= 0.0 && d < 4294967296.0 && double(uint32_t(d)) == d)
+	{
+		v = arrays_[a]->dense(uint32_t(d));
+	}
+	if (v == NULL || v->type_ != Value::Type::NUMBER)
+	{
+		throw Abort();
+	}
+
+	int dst = temp(Value::Type::NUMBER);
+	vals_[dst] = v->toNumber();
+	trace_->ops_.push_back(TraceOp(TraceOp::Code::ELEM, dst, i, a));
+	return dst;
+}
+
+int TraceRecorder::length(ObjectMember* m)
+{
+	if (dynamic_cast<Identifier*>(m->attr_)->atom_ != LENGTH)
+	{
+		throw Abort();
+	}
+
+	int a = array(m->base_);
+	int dst = temp(Value::Type::NUMBER);
+	vals_[dst] = arrays_[a]->length();
+	trace_->ops_.push_back(TraceOp(TraceOp::Code::LENGTH, dst, a, a));
+	return dst;
+}
+
+int TraceRecorder::expr(AST* code)
+{
+	if (code == NULL)
+	{
+		throw Abort();
+	}
+
+	switch (code->type_)
+	{
+		case AST::Type::GROUP_EXPR:
+		{
+			int ret = -1;
+			for (auto e : *dynamic_cast<GroupExpression*>(code)->elist_)
+			{
+				ret = expr(e);
+			}
+			if (ret < 0)
+			{
+				throw Abort();
+			}
+			return ret;
+		}
+
+		case AST::Type::IDENTIFIER:
+		{
+			int reg = var(dynamic_cast<Identifier*>(code));
+			if (types_[reg] == Value::Type::ARRAY)
+			{
+				throw Abort();
+			}
+			return reg;
+		}
+
+		case AST::Type::ARRAY_MEMBER:
+			return element(dynamic_cast<ArrayMember*>(code));
+
+		case AST::Type::OBJECT_MEMBER:
+			return length(dynamic_cast<ObjectMember*>(code));
+
+		case AST::Type::LITERAL_NUMBER:
+		{
+			auto n = CAST(Number, vm_->exec(dynamic_cast<LiteralNumber*>(code)));
+			if (n == nullptr)
+			{
+				throw Abort();
+			}
+			return constant(Value::Type::NUMBER, n->num_);
+		}
+
+		case AST::Type::LITERAL_BOOL:
+			return constant(Value::Type::BOOL,
+				dynamic_cast<LiteralBool*>(code)->b_ ? 1.0 : 0.0);
+
+		case AST::Type::BIN_EXPR:
+			return binary(dynamic_cast<BiExpression*>(code));
+
+		case AST::Type::UNI_EXPR:
+			return unary(dynamic_cast<UniExpression*>(code));
+
+		case AST::Type::TRI_EXPR:
+		{
+			auto tri = dynamic_cast<TriExpression*>(code);
+			return expr(guard(expr(tri->cond_)) ? tri->yes_ : tri->no_);
+		}
+
+		default:
+			throw Abort();
+	}
+}
+
+void TraceRecorder::stmt(AST* code)
+{
+	if (code == NULL || flow_ != RUN)
+	{
+		return;
+	}
+
+	switch (code->type_)
+	{
+		case AST::Type::EMPTY:
+			return;
+
+		case AST::Type::BLOCK:
+			for (auto i : *dynamic_cast<Block*>(code)->stmts_)
+			{
+				stmt(i);
+			}
+			return;
+
+		case AST::Type::CONDITION:
+		{
+			auto c = dynamic_cast<Condition*>(code);
+			stmt(guard(expr(c->cond_)) ? c->yes_ : c->no_);
+			return;
+		}
+
+		case AST::Type::VAR:
+			for (auto d : *dynamic_cast<Var*>(code)->vlist_)
+			{
+				if (d->init_ == NULL)
+				{
+					throw Abort();
+				}
+				store(d->id_, expr(d->init_));
+			}
+			return;
+
+		case AST::Type::BREAK:
+			trace_->ops_.push_back(TraceOp(TraceOp::Code::EXIT, -1, -1, -1));
+			flow_ = BREAK;
+			return;
+
+		case AST::Type::CONTINUE:
+			flow_ = CONTINUE;
+			return;
+
+		case AST::Type::GROUP_EXPR:
+		case AST::Type::BIN_EXPR:
+		case AST::Type::UNI_EXPR:
+		case AST::Type::TRI_EXPR:
+			expr(code);
+			return;
+
+		default:
+			throw Abort();
+	}
+}
+
+void TraceRecorder::finish()
+{
+	std::vector<int> remap(vals_.size());
+	int next = 0;
+
+	for (auto r : vars_)
+	{
+		remap[r] = next++;
+	}
+
+	for (auto r : consts_)
+	{
+		remap[r] = next++;
+		trace_->consts_.push_back(vals_[r]);
+	}
+
+	for (size_t i = 0; i < kinds_.size(); ++i)
+	{
+		if (kinds_[i] == REG_TEMP)
+		{
+			remap[i] = next++;
+		}
+	}
+
+	for (auto& op : trace_->ops_)
+	{
+		op.dst_ = op.dst_ < 0 ? 0 : remap[op.dst_];
+		op.a_ = op.a_ < 0 ? 0 : remap[op.a_];
+		op.b_ = op.b_ < 0 ? 0 : remap[op.b_];
+	}
+
+	trace_->nregs_ = next;
+}
+
+TraceRecorder::Status TraceRecorder::record(AST* cond, AST* body, AST* iter)
+{
+	try
+	{
+		int c = expr(cond);
+
+		if (!truth(c))
+		{
+			return Status::LOOP_EXIT;
+		}
+
+		trace_->ops_.push_back(TraceOp(TraceOp::Code::EXIT_UNLESS, -1, c, c));
+
+		stmt(body);
+
+		if (flow_ != BREAK && iter)
+		{
+			expr(iter);
+		}
+	}
+	catch (Abort&)
+	{
+		return Status::UNTRACEABLE;
+	}
+
+	finish();
+
+	return Status::RECORDED;
+}
+
+NAMESPACE_END
@@ -0,0 +1,218 @@
+#ifndef _HOTLOOP_H_
+#define _HOTLOOP_H_
+
+#include "value.h"
+#include "budget.h"
+
+NAMESPACE_BEGIN
+
+class VM;
+
+struct TraceOp {
+	enum Code {
+		MOV,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		MOD,
+		BAND,
+		BOR,
+		BXOR,
+		SHL,
+		SHR,
+		NEG,
+		BNOT,
+		LT,
+		LE,
+		GT,
+		GE,
+		EQ,
+		NE,
+		NOT,
+		TRUTH,
+		ELEM,
+		LENGTH,
+		GUARD_TRUE,
+		GUARD_FALSE,
+		GUARD_NONZERO,
+		EXIT_UNLESS,
+		EXIT
+	};
+
+	Code code_;
+	int dst_;
+	int a_;
+	int b_;
+
+	TraceOp(Code code, int dst, int a, int b):
+		code_(code), dst_(dst), a_(a), b_(b)
+	{}
+
+	/* ToBoolean of a number: NaN and both zeros are false */
+	static inline bool truthy(double a)
+	{
+		return a == a && a != 0.0;
+	}
+
+	static inline double eval(Code code, double a, double b)
+	{
+		switch (code)
+		{
+			case MOV: return a;
+			case ADD: return a + b;
+			case SUB: return a - b;
+			case MUL: return a * b;
+			case DIV: return a / b;
+			case MOD: return std::fmod(a, b);
+			case BAND: return double(wrap32(a) & wrap32(b));
+			case BOR: return double(wrap32(a) | wrap32(b));
+			case BXOR: return double(wrap32(a) ^ wrap32(b));
+			case SHL: return double(shiftLeft32(a, b));
+			case SHR: return double(shiftRight32(a, b));
+			case NEG: return -a;
+			case BNOT: return double(~wrap32(a));
+			case LT: return a < b;
+			case LE: return a <= b;
+			case GT: return a > b;
+			case GE: return a >= b;
+			case EQ: return a == b;
+			case NE: return a != b;
+			case NOT: return !truthy(a);
+			case TRUTH: return truthy(a);
+			default: return 0.0;
+		}
+	}
+};
+
+/*
+ * A variable the trace keeps unboxed in a register: a global found through
+ * owner_, or a frame slot or Env cell of the running activation. An array
+ * variable only holds the array the trace reads elements from; its
+ * register is unused.
+ */
+struct TraceVar {
+	Atom name_;
+	Scope* owner_;
+	std::vector<Scope*> scopes_;
+	Identifier* local_;
+	Value::Type type_;
+	bool written_;
+
+	TraceVar(Identifier* id, Scope* owner, Value::Type type):
+		name_(id->atom_), owner_(owner), local_(owner ? NULL : id),
+		type_(type), written_(false)
+	{}
+
+	bool same(Identifier* id, Scope* owner)
+	{
+		if (owner)
+		{
+			return owner_ == owner && name_ == id->atom_;
+		}
+		return local_ && local_->binding_ == id->binding_
+			&& local_->index_ == id->index_ && local_->depth_ == id->depth_;
+	}
+};
+
+/*
+ * One recorded loop iteration over unboxed registers.
+ * Registers [0, vars_.size()) hold variables, followed by constants
+ * and temporaries. Types are checked once on entry; a guard failure
+ * rolls the registers back to the start of the iteration and hands
+ * that iteration to the interpreter. Element loads are guarded the same
+ * way: the index must fall in the array's dense part and the element
+ * must be a number. Traces never store to arrays, so the arrays found
+ * on entry stay valid for the whole run.
+ */
+class LoopTrace {
+public:
+	static const int HOT_LOOP = 32;
+	static const int MAX_SIDE_EXITS = 16;
+	static const int MAX_RECORDS = 3;
+
+	enum Result {
+		NOT_ENTERED,
+		LOOP_DONE,
+		SIDE_EXIT,
+		PREEMPTED
+	};
+
+	std::vector<TraceVar> vars_;
+	std::vector<double> consts_;
+	std::vector<TraceOp> ops_;
+	int nregs_;
+
+private:
+	std::vector<double> regs_;
+	std::vector<double> snapshot_;
+	std::vector<ValuePtr*> cells_;
+	std::vector<ArrayValue*> arrays_;
+
+	bool enter(Frame* frame);
+	void leave();
+
+public:
+	LoopTrace(): nregs_(0)
+	{}
+
+	Result run(Frame* frame, ExecBudget& budget);
+};
+
+class TraceRecorder {
+public:
+	enum Status {
+		RECORDED,
+		LOOP_EXIT,
+		UNTRACEABLE
+	};
+
+private:
+	struct Abort {};
+
+	VM* vm_;
+	LoopTrace* trace_;
+	std::vector<double> vals_;
+	std::vector<Value::Type> types_;
+	std::vector<int> kinds_;
+	std::vector<ArrayValue*> arrays_;
+	std::vector<int> vars_;
+	std::vector<int> consts_;
+	enum {
+		RUN,
+		CONTINUE,
+		BREAK
+	} flow_;
+
+	int newReg(int kind, Value::Type type, double val);
+	int var(Identifier* id);
+	int constant(Value::Type type, double val);
+	int temp(Value::Type type);
+	int emit(TraceOp::Code code, Value::Type type, int a, int b);
+	bool guard(int reg);
+	void store(Identifier* id, int reg);
+	bool truth(int reg);
+	int num(int reg);
+	int array(AST* base);
+
+	int expr(AST* code);
+	int assign(AST* left, int reg);
+	int binary(BiExpression* bi);
+	int unary(UniExpression* u);
+	int element(ArrayMember* m);
+	int length(ObjectMember* m);
+	void stmt(AST* code);
+
+	void finish();
+
+public:
+	TraceRecorder(VM* vm);
+	~TraceRecorder();
+
+	Status record(AST* cond, AST* body, AST* iter);
+	LoopTrace* release();
+};
+
+NAMESPACE_END
+
+#endif
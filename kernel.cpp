@@ -0,0 +1,346 @@
+#include "kernel.h"
+
+NAMESPACE_BEGIN
+
+struct Family {
+	enum Type {
+		ARITH,
+		CONCAT,
+		COMPARE,
+		STRICT
+	};
+};
+
+template<int OP> struct Operator;
+
+/*
+ * Int32 versions of the arithmetic operators. They return false when
+ * the result does not fit (or would be -0) and the double path runs.
+ */
+static inline bool smallAdd(int32_t a, int32_t b, int32_t& r)
+{
+	return !__builtin_add_overflow(a, b, &r);
+}
+
+static inline bool smallSub(int32_t a, int32_t b, int32_t& r)
+{
+	return !__builtin_sub_overflow(a, b, &r);
+}
+
+static inline bool smallMul(int32_t a, int32_t b, int32_t& r)
+{
+	return !__builtin_mul_overflow(a, b, &r) && (r != 0 || (a >= 0 && b >= 0));
+}
+
+static inline bool smallDiv(int32_t a, int32_t b, int32_t& r)
+{
+	if (b == 0 || (a == 0 && b < 0) || (a == INT32_MIN && b == -1) || a % b != 0)
+	{
+		return false;
+	}
+	r = a / b;
+	return true;
+}
+
+static inline bool smallMod(int32_t a, int32_t b, int32_t& r)
+{
+	if (b == 0)
+	{
+		return false;
+	}
+	r = b == -1 ? 0 : a % b;
+	return r != 0 || a >= 0;
+}
+
+static inline bool smallAnd(int32_t a, int32_t b, int32_t& r)
+{
+	r = a & b;
+	return true;
+}
+
+static inline bool smallOr(int32_t a, int32_t b, int32_t& r)
+{
+	r = a | b;
+	return true;
+}
+
+static inline bool smallXor(int32_t a, int32_t b, int32_t& r)
+{
+	r = a ^ b;
+	return true;
+}
+
+static inline bool smallShl(int32_t a, int32_t b, int32_t& r)
+{
+	r = int32_t(uint32_t(a) << (b & 31));
+	return true;
+}
+
+static inline bool smallShr(int32_t a, int32_t b, int32_t& r)
+{
+	r = a >> (b & 31);
+	return true;
+}
+
+#define ARITH_OP(op, expr, fast) \
+	template<> struct Operator<BiExpression::Op::op> { \
+		static const int FAMILY = Family::ARITH; \
+		static double num(double a, double b) { return expr; } \
+		static bool small(int32_t a, int32_t b, int32_t& r) { return fast(a, b, r); } \
+	};
+
+#define COMPARE_OP(op, expr, equality) \
+	template<> struct Operator<BiExpression::Op::op> { \
+		static const int FAMILY = Family::COMPARE; \
+		static const bool EQUALITY = equality; \
+		template<typename A, typename B> \
+		static bool cmp(const A& a, const B& b) { return expr; } \
+	};
+
+#define STRICT_OP(op, negate) \
+	template<> struct Operator<BiExpression::Op::op> { \
+		static const int FAMILY = Family::STRICT; \
+		static const bool NEGATE = negate; \
+	};
+
+template<> struct Operator<BiExpression::Op::PLUS> {
+	static const int FAMILY = Family::CONCAT;
+	static double num(double a, double b) { return a + b; }
+	static bool small(int32_t a, int32_t b, int32_t& r) { return smallAdd(a, b, r); }
+};
+
+ARITH_OP(MINUS, a - b, smallSub)
+ARITH_OP(MUL, a * b, smallMul)
+ARITH_OP(DIV, a / b, smallDiv)
+ARITH_OP(MOD, std::fmod(a, b), smallMod)
+ARITH_OP(BAND, double(wrap32(a) & wrap32(b)), smallAnd)
+ARITH_OP(BOR, double(wrap32(a) | wrap32(b)), smallOr)
+ARITH_OP(BXOR, double(wrap32(a) ^ wrap32(b)), smallXor)
+ARITH_OP(LSHIFT, double(shiftLeft32(a, b)), smallShl)
+ARITH_OP(RSHIFT, double(shiftRight32(a, b)), smallShr)
+
+COMPARE_OP(LS, a < b, false)
+COMPARE_OP(LE, a <= b, false)
+COMPARE_OP(GT, a > b, false)
+COMPARE_OP(GE, a >= b, false)
+COMPARE_OP(EQ, a == b, true)
+COMPARE_OP(NEQ, a != b, true)
+
+STRICT_OP(TEQ, false)
+STRICT_OP(NTEQ, true)
+
+#undef ARITH_OP
+#undef COMPARE_OP
+#undef STRICT_OP
+
+static inline const Number* number(const ValuePtr& v)
+{
+	return static_cast<const Number*>(v.get());
+}
+
+template<int OP>
+static inline ValuePtr arith(const ValuePtr& left, const ValuePtr& right)
+{
+	const Number* a = number(left);
+	const Number* b = number(right);
+	int32_t r;
+	if (a->isInt_ && b->isInt_ && Operator<OP>::small(a->int_, b->int_, r))
+	{
+		return ValuePtr(new Number(r));
+	}
+	return ValuePtr(new Number(Operator<OP>::num(a->num_, b->num_)));
+}
+
+/* Values that convert to strings rather than numbers */
+template<int K> struct Textual {
+	static const bool VALUE = K == Value::Type::STRING || K == Value::Type::OBJECT
+		|| K == Value::Type::FUNCTION || K == Value::Type::ARRAY || K == Value::Type::TYPED_ARRAY;
+};
+
+/* Values compared by identity: the textual kinds other than strings */
+template<int K> struct Reference {
+	static const bool VALUE = Textual<K>::VALUE && K != Value::Type::STRING;
+};
+
+template<int K> struct Nullish {
+	static const bool VALUE = K == Value::Type::UNDEFINED || K == Value::Type::NULLVAL;
+};
+
+template<int OP>
+static inline ValuePtr numeric(double a, double b)
+{
+	int32_t x, y, r;
+	if (Number::toInt32(a, x) && Number::toInt32(b, y) && Operator<OP>::small(x, y, r))
+	{
+		return ValuePtr(new Number(r));
+	}
+	double d = Operator<OP>::num(a, b);
+	return std::isnan(d) ? NotaNumber::instance() : ValuePtr(new Number(d));
+}
+
+template<int K> struct Text {
+	static std::string get(const ValuePtr& v)
+	{
+		return v->toString();
+	}
+};
+
+template<> struct Text<Value::Type::STRING> {
+	static const std::string& get(const ValuePtr& v)
+	{
+		return static_cast<StringValue*>(v.get())->str();
+	}
+};
+
+template<int K> struct Str {
+	static ValuePtr get(const ValuePtr& v)
+	{
+		return ValuePtr(new StringValue(v->toString()));
+	}
+};
+
+template<> struct Str<Value::Type::STRING> {
+	static const ValuePtr& get(const ValuePtr& v)
+	{
+		return v;
+	}
+};
+
+template<int K> struct TypeOf {
+	static const int VALUE = K == KIND_NAN ? int(Value::Type::NUMBER) : K;
+};
+
+template<int OP, int L, int R,
+	int F = Operator<OP>::FAMILY,
+	bool N = L == Value::Type::NUMBER && R == Value::Type::NUMBER>
+struct KernelOf;
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::ARITH, true> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		return arith<OP>(left, right);
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::ARITH, false> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		return numeric<OP>(left->toNumber(), right->toNumber());
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::CONCAT, true> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		return arith<OP>(left, right);
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::CONCAT, false> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		if (!Textual<L>::VALUE && !Textual<R>::VALUE)
+		{
+			return numeric<OP>(left->toNumber(), right->toNumber());
+		}
+		return StringValue::concat(Str<L>::get(left), Str<R>::get(right));
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::COMPARE, true> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		const Number* a = number(left);
+		const Number* b = number(right);
+		if (a->isInt_ && b->isInt_)
+		{
+			return ValuePtr(new Boolean(Operator<OP>::cmp(a->int_, b->int_)));
+		}
+		return ValuePtr(new Boolean(Operator<OP>::cmp(a->num_, b->num_)));
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::COMPARE, false> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		if (Operator<OP>::EQUALITY && Reference<L>::VALUE && Reference<R>::VALUE)
+		{
+			return ValuePtr(new Boolean(Operator<OP>::cmp(left.get(), right.get())));
+		}
+		if (Textual<L>::VALUE && Textual<R>::VALUE)
+		{
+			return ValuePtr(new Boolean(Operator<OP>::cmp(
+				Text<L>::get(left), Text<R>::get(right))));
+		}
+		if (Operator<OP>::EQUALITY && (Nullish<L>::VALUE || Nullish<R>::VALUE))
+		{
+			return ValuePtr(new Boolean(Operator<OP>::cmp(bool(Nullish<L>::VALUE), bool(Nullish<R>::VALUE))));
+		}
+		return ValuePtr(new Boolean(Operator<OP>::cmp(left->toNumber(), right->toNumber())));
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::STRICT, true> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		const Number* a = number(left);
+		const Number* b = number(right);
+		bool eq = a->isInt_ && b->isInt_ ? a->int_ == b->int_ : a->num_ == b->num_;
+		return ValuePtr(new Boolean(eq != Operator<OP>::NEGATE));
+	}
+};
+
+template<int OP, int L, int R>
+struct KernelOf<OP, L, R, Family::STRICT, false> {
+	static ValuePtr run(const ValuePtr& left, const ValuePtr& right)
+	{
+		if (TypeOf<L>::VALUE != TypeOf<R>::VALUE || L == KIND_NAN || R == KIND_NAN)
+		{
+			return ValuePtr(new Boolean(Operator<OP>::NEGATE));
+		}
+		if (Reference<L>::VALUE)
+		{
+			return ValuePtr(new Boolean((left.get() == right.get()) != Operator<OP>::NEGATE));
+		}
+		return ValuePtr(new Boolean((Text<L>::get(left) == Text<R>::get(right))
+			!= Operator<OP>::NEGATE));
+	}
+};
+
+template<int... I> struct Seq {
+	typedef Seq type;
+};
+
+template<typename A, typename B> struct Concat;
+
+template<int... A, int... B>
+struct Concat<Seq<A...>, Seq<B...>>: Seq<A..., int(sizeof...(A)) + B...> {};
+
+template<int N> struct MakeSeq:
+	Concat<typename MakeSeq<N / 2>::type, typename MakeSeq<N - N / 2>::type> {};
+
+template<> struct MakeSeq<0>: Seq<> {};
+template<> struct MakeSeq<1>: Seq<0> {};
+
+template<typename S> struct Table;
+
+template<int... I>
+struct Table<Seq<I...>> {
+	static const Kernel value[sizeof...(I)];
+};
+
+template<int... I>
+const Kernel Table<Seq<I...>>::value[sizeof...(I)] = {
+	&KernelOf<I / (KINDS * KINDS), I / KINDS % KINDS, I % KINDS>::run...
+};
+
+const Kernel* const KERNELS = Table<MakeSeq<KERNEL_OPS * KINDS * KINDS>::type>::value;
+
+NAMESPACE_END
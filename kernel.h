@@ -0,0 +1,46 @@
+#ifndef _KERNEL_H_
+#define _KERNEL_H_
+
+#include "value.h"
+
+NAMESPACE_BEGIN
+
+/*
+ * Binary operator kernels, one per (operator, left kind, right kind).
+ * A value's kind is its Value::Type, except that NaN gets its own kind
+ * so the number kernels never have to look for it.
+ */
+typedef ValuePtr (*Kernel)(const ValuePtr& left, const ValuePtr& right);
+
+enum {
+	KIND_NAN = Value::Type::SIGNAL + 1,
+	KINDS
+};
+
+static const int KERNEL_OPS = BiExpression::Op::NTEQ + 1;
+
+extern const Kernel* const KERNELS;
+
+inline int kindOf(const ValuePtr& v)
+{
+	if (v->type_ == Value::Type::NUMBER
+		&& v.get() == NotaNumber::instance().get())
+	{
+		return KIND_NAN;
+	}
+	return v->type_;
+}
+
+inline Kernel kernel(BiExpression::Op op, int left, int right)
+{
+	return KERNELS[(op * KINDS + left) * KINDS + right];
+}
+
+inline ValuePtr operate(BiExpression::Op op, const ValuePtr& left, const ValuePtr& right)
+{
+	return kernel(op, kindOf(left), kindOf(right))(left, right);
+}
+
+NAMESPACE_END
+
+#endif
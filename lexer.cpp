@@ -236,7 +236,7 @@ void Lexer::process(const std::string& source)
 				++forward;
 			}
 		}
-		else if (isDigit(c))
+		else if (isDigit(c) || (c == '.' && isDigit(source[forward])))
 		{
 			int base = 10;
 
@@ -254,14 +254,6 @@ void Lexer::process(const std::string& source)
 						break;
 					case 'O':
 					case 'o':
-					case '0':
-					case '1':
-					case '2':
-					case '3':
-					case '4':
-					case '5':
-					case '6':
-					case '7':
 						base = 8;
 						break;
 					default:
@@ -275,27 +267,34 @@ void Lexer::process(const std::string& source)
 				++forward;
 			}
 
-			if (source[forward] == '.')
+			if (base == 10 && c != '.' && source[forward] == '.')
 			{
 				++forward;
-				while (isDigit(source[forward], base))
+				while (isDigit(source[forward]))
 				{
 					++forward;
 				}
 			}
 
-			if (source[forward] == 'e' || source[forward] == 'E')
+			if (base == 10 && (source[forward] == 'e' || source[forward] == 'E'))
 			{
-				++forward;
-				if (source[forward] == '+' || source[forward] == '-')
+				int exp = forward + 1;
+				if (source[exp] == '+' || source[exp] == '-')
+				{
+					++exp;
+				}
+				if (isDigit(source[exp]))
 				{
-					while (isDigit(source[forward], base))
+					forward = exp;
+					while (isDigit(source[forward]))
 					{
 						++forward;
 					}
 				}
 			}
 
+			col += forward - cur - 1;
+
 			Position end(line, col);
 			std::string data = source.substr(cur, forward-cur);
 
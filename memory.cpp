@@ -0,0 +1,184 @@
+#include "memory.h"
+#include "allocprofile.h"
+
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+NAMESPACE_BEGIN
+
+thread_local MemoryAccount* MemoryAccount::current_ = NULL;
+
+MemoryAccount::MemoryAccount(): limit_(0), softLimit_(0), callback_(NULL),
+	ctx_(NULL), softFired_(false)
+{
+	ledger_ = static_cast<Ledger*>(calloc(1, sizeof(Ledger)));
+	if (ledger_ == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	ledger_->next_ = INT64_MAX;
+}
+
+MemoryAccount::~MemoryAccount()
+{
+	if (current_ == this)
+	{
+		current_ = NULL;
+	}
+
+	ledger_->closed_ = true;
+	if (ledger_->blocks_ == 0)
+	{
+		free(ledger_);
+	}
+}
+
+void MemoryAccount::setLimit(size_t bytes)
+{
+	limit_ = bytes;
+	rearm();
+}
+
+void MemoryAccount::setSoftLimit(size_t bytes, Callback callback, void* ctx)
+{
+	softLimit_ = bytes;
+	callback_ = callback;
+	ctx_ = ctx;
+	softFired_ = false;
+	rearm();
+}
+
+/* next_ is the lowest threshold still to report */
+void MemoryAccount::rearm()
+{
+	int64_t next = INT64_MAX;
+	if (callback_ && softLimit_ && !softFired_)
+	{
+		next = softLimit_;
+	}
+	if (limit_ && int64_t(limit_) < next)
+	{
+		next = limit_;
+	}
+	ledger_->next_ = next;
+	ledger_->tripped_ = ledger_->used_ > next;
+}
+
+bool MemoryAccount::check()
+{
+	if (callback_ && softLimit_ && !softFired_ && ledger_->used_ > int64_t(softLimit_))
+	{
+		softFired_ = true;
+		callback_(ctx_, used());
+	}
+
+	rearm();
+	return limit_ && ledger_->used_ > int64_t(limit_);
+}
+
+NAMESPACE_END
+
+using cl::AllocProfile;
+using cl::MemoryAccount;
+
+/* Every block starts with the ledger it was charged to, padded to keep malloc's alignment */
+static const size_t HEADER = 16;
+
+static inline void* allocate(size_t bytes)
+{
+	MemoryAccount* account = MemoryAccount::current();
+
+	if (account && account->refuse(bytes))
+	{
+		throw std::bad_alloc();
+	}
+
+	char* p = static_cast<char*>(malloc(HEADER + bytes));
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	MemoryAccount::Ledger* ledger = account ? account->ledger() : NULL;
+	*reinterpret_cast<MemoryAccount::Ledger**>(p) = ledger;
+	if (ledger)
+	{
+		MemoryAccount::charge(ledger, malloc_usable_size(p));
+	}
+	if (AllocProfile* allocs = AllocProfile::current())
+	{
+		allocs->allocated(p + HEADER, bytes);
+	}
+	return p + HEADER;
+}
+
+static inline void deallocate(void* p)
+{
+	if (p == NULL)
+	{
+		return;
+	}
+
+	char* block = static_cast<char*>(p) - HEADER;
+	MemoryAccount::Ledger* ledger = *reinterpret_cast<MemoryAccount::Ledger**>(block);
+	if (ledger)
+	{
+		MemoryAccount::release(ledger, malloc_usable_size(block));
+	}
+	free(block);
+}
+
+void* operator new(size_t bytes)
+{
+	return allocate(bytes);
+}
+
+void* operator new[](size_t bytes)
+{
+	return allocate(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return allocate(bytes);
+	}
+	catch (std::bad_alloc&)
+	{
+		return NULL;
+	}
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return allocate(bytes);
+	}
+	catch (std::bad_alloc&)
+	{
+		return NULL;
+	}
+}
+
+void operator delete(void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	deallocate(p);
+}
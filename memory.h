@@ -0,0 +1,131 @@
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include "common.h"
+
+#include <cstdlib>
+
+NAMESPACE_BEGIN
+
+/*
+ * Heap bytes allocated on behalf of one VM. The engine replaces the
+ * global operator new and delete, so values, property maps, strings and
+ * scopes are all charged to the account installed on the allocating
+ * thread, which the VM does for the length of each run. Each block
+ * records the ledger it was charged to and credits that ledger when it
+ * is freed, whichever account is current then; a ledger outlives its
+ * account until the last of its blocks is gone.
+ *
+ * Structures shared between threads, whose blocks another thread may
+ * free, allocate under Suspend so that no account's ledger is touched
+ * from two threads.
+ *
+ * Crossing a limit only raises tripped(); the VM polls it where it can
+ * safely unwind, runs the soft-limit callback there and aborts the script
+ * past the hard limit. A single large request past the hard limit is
+ * refused outright with std::bad_alloc, so it cannot exhaust the process.
+ */
+class MemoryAccount {
+public:
+	typedef void (*Callback)(void* ctx, size_t used);
+
+	/* Smallest request refused at allocation time */
+	static const size_t LARGE = 1 << 16;
+
+	struct Ledger {
+		int64_t used_;
+		int64_t peak_;
+		int64_t next_;
+		int64_t blocks_;
+		bool tripped_;
+		bool closed_;
+	};
+
+private:
+	static thread_local MemoryAccount* current_;
+
+	Ledger* ledger_;
+	size_t limit_;
+	size_t softLimit_;
+	Callback callback_;
+	void* ctx_;
+	bool softFired_;
+
+	void rearm();
+
+	MemoryAccount(const MemoryAccount&);
+	MemoryAccount& operator=(const MemoryAccount&);
+
+public:
+	MemoryAccount();
+	~MemoryAccount();
+
+	/* 0 removes the limit */
+	void setLimit(size_t bytes);
+	void setSoftLimit(size_t bytes, Callback callback, void* ctx);
+
+	inline size_t used() { return ledger_->used_ > 0 ? ledger_->used_ : 0; }
+	inline size_t peak() { return ledger_->peak_ > 0 ? ledger_->peak_ : 0; }
+	inline size_t limit() { return limit_; }
+	inline bool tripped() { return ledger_->tripped_; }
+	inline Ledger* ledger() { return ledger_; }
+
+	/* Runs a due soft-limit callback; true when the hard limit is exceeded */
+	bool check();
+
+	static inline void charge(Ledger* l, size_t bytes)
+	{
+		l->used_ += bytes;
+		++l->blocks_;
+		if (l->used_ > l->peak_)
+		{
+			l->peak_ = l->used_;
+		}
+		if (l->used_ > l->next_)
+		{
+			l->tripped_ = true;
+		}
+	}
+	/* Frees a closed ledger once its last block is released */
+	static inline void release(Ledger* l, size_t bytes)
+	{
+		l->used_ -= bytes;
+		if (--l->blocks_ == 0 && l->closed_)
+		{
+			free(l);
+		}
+	}
+	inline bool refuse(size_t bytes)
+	{
+		return limit_ && bytes >= LARGE && ledger_->used_ + int64_t(bytes) > int64_t(limit_);
+	}
+
+	static inline MemoryAccount* current() { return current_; }
+
+	/* Charges the thread's allocations to an account for its lifetime */
+	class Use {
+	private:
+		MemoryAccount* prev_;
+
+	public:
+		Use(MemoryAccount* account): prev_(current_)
+		{
+			current_ = account;
+		}
+		~Use()
+		{
+			current_ = prev_;
+		}
+	};
+
+	/* Charges the thread's allocations to no account for its lifetime */
+	class Suspend: public Use {
+	public:
+		Suspend(): Use(NULL)
+		{}
+	};
+};
+
+NAMESPACE_END
+
+#endif
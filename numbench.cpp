@@ -0,0 +1,133 @@
+#include "numconv.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace cl;
+
+/*
+ * Formatting and parsing throughput over typical numeric output:
+ * counters, two-decimal amounts, ratios and arbitrary doubles. Each set
+ * is also checked to read back exactly.
+ */
+static const size_t COUNT = 1000000;
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPer(Clock::time_point start, size_t n)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+}
+
+static std::vector<double> dataset(const std::string& name)
+{
+	std::mt19937_64 rng(42);
+	std::vector<double> ret(COUNT);
+
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		if (name == "integers")
+		{
+			ret[i] = double(rng() % 10000000);
+		}
+		else if (name == "amounts")
+		{
+			ret[i] = double(rng() % 10000000) / 100;
+		}
+		else if (name == "ratios")
+		{
+			ret[i] = std::uniform_real_distribution<double>(0, 1)(rng);
+		}
+		else
+		{
+			uint64_t bits;
+			do
+			{
+				bits = rng();
+				memcpy(&ret[i], &bits, sizeof(bits));
+			} while (!std::isfinite(ret[i]));
+		}
+	}
+	return ret;
+}
+
+static void run(const std::string& name)
+{
+	auto data = dataset(name);
+	std::vector<std::string> text(COUNT);
+	char buf[NUMBER_BUFFER];
+	size_t sink = 0;
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		sink += formatNumber(data[i], buf);
+	}
+	double format = nsPer(start, COUNT);
+
+	start = Clock::now();
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		sink += std::to_string(data[i]).length();
+	}
+	double toString = nsPer(start, COUNT);
+
+	start = Clock::now();
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		sink += snprintf(buf, sizeof(buf), "%.17g", data[i]);
+	}
+	double printf17 = nsPer(start, COUNT);
+
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		text[i] = formatNumber(data[i]);
+	}
+
+	double acc = 0;
+	start = Clock::now();
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		acc += stringToNumber(text[i]);
+	}
+	double parse = nsPer(start, COUNT);
+
+	start = Clock::now();
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		acc += std::strtod(text[i].c_str(), NULL);
+	}
+	double strtod = nsPer(start, COUNT);
+
+	size_t bad = 0;
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		if (stringToNumber(text[i]) != data[i] || std::strtod(text[i].c_str(), NULL) != data[i])
+		{
+			bad++;
+		}
+	}
+
+	printf("%-9s format %6.1f ns (to_string %6.1f, %%.17g %6.1f)  parse %6.1f ns (strtod %6.1f)  mismatches %zu\n",
+		name.c_str(), format, toString, printf17, parse, strtod, bad);
+
+	if (sink == 0 && acc == 0)
+	{
+		printf("\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* sets[] = {"integers", "amounts", "ratios", "doubles"};
+
+	for (auto name : sets)
+	{
+		run(name);
+	}
+
+	return 0;
+}
@@ -0,0 +1,583 @@
+#include "numconv.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <limits>
+
+NAMESPACE_BEGIN
+
+static const uint64_t EXP_MASK = 0x7FF0000000000000ULL;
+static const uint64_t FRAC_MASK = 0x000FFFFFFFFFFFFFULL;
+static const uint64_t HIDDEN = 0x0010000000000000ULL;
+
+static const uint64_t POW10[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+	10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/* Powers of ten that are exact as doubles */
+static const double EXACT10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* A double as an unnormalised significand and binary exponent */
+struct DiyFp {
+	uint64_t f_;
+	int e_;
+
+	DiyFp(uint64_t f, int e): f_(f), e_(e)
+	{}
+
+	explicit DiyFp(double d)
+	{
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		int biased = int((bits & EXP_MASK) >> 52);
+		uint64_t significand = bits & FRAC_MASK;
+		if (biased)
+		{
+			f_ = significand + HIDDEN;
+			e_ = biased - 1075;
+		}
+		else
+		{
+			f_ = significand;
+			e_ = -1074;
+		}
+	}
+
+	DiyFp operator-(const DiyFp& rhs) const
+	{
+		return DiyFp(f_ - rhs.f_, e_);
+	}
+
+	/* Upper 64 bits of the product, rounded */
+	DiyFp operator*(const DiyFp& rhs) const
+	{
+		const uint64_t M32 = 0xFFFFFFFFULL;
+		uint64_t a = f_ >> 32, b = f_ & M32;
+		uint64_t c = rhs.f_ >> 32, d = rhs.f_ & M32;
+		uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+		uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+		tmp += 1ULL << 31;
+		return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e_ + rhs.e_ + 64);
+	}
+
+	DiyFp normalize() const
+	{
+		DiyFp r = *this;
+		while (!(r.f_ & (1ULL << 63)))
+		{
+			r.f_ <<= 1;
+			r.e_--;
+		}
+		return r;
+	}
+
+	DiyFp normalizeBoundary() const
+	{
+		DiyFp r = *this;
+		while (!(r.f_ & (HIDDEN << 1)))
+		{
+			r.f_ <<= 1;
+			r.e_--;
+		}
+		r.f_ <<= 64 - 52 - 2;
+		r.e_ -= 64 - 52 - 2;
+		return r;
+	}
+
+	/* Midpoints to the neighbouring doubles, sharing plus's exponent */
+	void boundaries(DiyFp& minus, DiyFp& plus) const
+	{
+		plus = DiyFp((f_ << 1) + 1, e_ - 1).normalizeBoundary();
+		minus = f_ == HIDDEN ? DiyFp((f_ << 2) - 1, e_ - 2) : DiyFp((f_ << 1) - 1, e_ - 1);
+		minus.f_ <<= minus.e_ - plus.e_;
+		minus.e_ = plus.e_;
+	}
+};
+
+/* Normalised 10^k for k = -348, -340, ..., 340 */
+static const struct {
+	uint64_t f_;
+	int e_;
+} POWERS[] = {
+	{0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166}, {0xcf42894a5dce35eaULL, -1140},
+	{0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087}, {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034},
+	{0xbe5691ef416bd60cULL, -1007}, {0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+	{0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847}, {0xc21094364dfb5637ULL, -821},
+	{0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768}, {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715},
+	{0xb23867fb2a35b28eULL, -688}, {0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+	{0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529}, {0xb5b5ada8aaff80b8ULL, -502},
+	{0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449}, {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396},
+	{0xa6dfbd9fb8e5b88fULL, -369}, {0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+	{0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210}, {0xaa242499697392d3ULL, -183},
+	{0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130}, {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77},
+	{0x9c40000000000000ULL, -50}, {0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+	{0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109}, {0x9f4f2726179a2245ULL, 136},
+	{0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189}, {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242},
+	{0x924d692ca61be758ULL, 269}, {0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+	{0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428}, {0x952ab45cfa97a0b3ULL, 455},
+	{0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508}, {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561},
+	{0x88fcf317f22241e2ULL, 588}, {0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+	{0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747}, {0x8bab8eefb6409c1aULL, 774},
+	{0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827}, {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880},
+	{0x80444b5e7aa7cf85ULL, 907}, {0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+	{0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+static DiyFp cachedPower(int e, int& K)
+{
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int k = int(dk);
+	if (dk - k > 0.0)
+	{
+		k++;
+	}
+
+	unsigned index = unsigned((k >> 3) + 1);
+	K = -(-348 + int(index << 3));
+	return DiyFp(POWERS[index].f_, POWERS[index].e_);
+}
+
+/*
+ * Moves the last digit down towards w while that stays inside the safe
+ * interval, then reports whether the digits are provably the shortest
+ * and closest: every distance is only known to within unit, so ties and
+ * near-misses give up.
+ */
+static bool roundWeed(char* buf, int len, uint64_t distance, uint64_t unsafe,
+	uint64_t rest, uint64_t tenKappa, uint64_t unit)
+{
+	uint64_t small = distance - unit;
+	uint64_t big = distance + unit;
+
+	while (rest < small && unsafe - rest >= tenKappa
+		&& (rest + tenKappa < small || small - rest >= rest + tenKappa - small))
+	{
+		buf[len - 1]--;
+		rest += tenKappa;
+	}
+
+	if (rest < big && unsafe - rest >= tenKappa
+		&& (rest + tenKappa < big || big - rest > rest + tenKappa - big))
+	{
+		return false;
+	}
+	return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+static int countDigits(uint32_t n)
+{
+	int k = 1;
+	while (k < 10 && n >= POW10[k])
+	{
+		k++;
+	}
+	return k;
+}
+
+/* Digits of the scaled w from the top of the interval (low, high), each bound off by one unit */
+static bool digitGen(const DiyFp& low, const DiyFp& w, const DiyFp& high,
+	char* buf, int& len, int& K)
+{
+	uint64_t unit = 1;
+	const DiyFp tooLow(low.f_ - unit, low.e_);
+	const DiyFp tooHigh(high.f_ + unit, high.e_);
+	uint64_t unsafe = (tooHigh - tooLow).f_;
+	const DiyFp one(1ULL << -w.e_, w.e_);
+	uint32_t p1 = uint32_t(tooHigh.f_ >> -one.e_);
+	uint64_t p2 = tooHigh.f_ & (one.f_ - 1);
+	int kappa = countDigits(p1);
+	len = 0;
+
+	while (kappa > 0)
+	{
+		uint32_t div = uint32_t(POW10[kappa - 1]);
+		buf[len++] = char('0' + p1 / div);
+		p1 %= div;
+		kappa--;
+
+		uint64_t rest = (uint64_t(p1) << -one.e_) + p2;
+		if (rest < unsafe)
+		{
+			K += kappa;
+			return roundWeed(buf, len, (tooHigh - w).f_, unsafe, rest, uint64_t(div) << -one.e_, unit);
+		}
+	}
+
+	for (;;)
+	{
+		p2 *= 10;
+		unit *= 10;
+		unsafe *= 10;
+		buf[len++] = char('0' + (p2 >> -one.e_));
+		p2 &= one.f_ - 1;
+		kappa--;
+
+		if (p2 < unsafe)
+		{
+			K += kappa;
+			return roundWeed(buf, len, (tooHigh - w).f_ * unit, unsafe, p2, one.f_, unit);
+		}
+	}
+}
+
+/*
+ * Shortest digits of a positive finite v with v == digits * 10^K (Grisu3);
+ * false for the few values whose digits it cannot prove shortest
+ */
+static bool grisu3(double v, char* buf, int& len, int& K)
+{
+	const DiyFp w(v);
+	DiyFp minus(0, 0), plus(0, 0);
+	w.boundaries(minus, plus);
+
+	const DiyFp c = cachedPower(plus.e_, K);
+	return digitGen(minus * c, w.normalize() * c, plus * c, buf, len, K);
+}
+
+/* The exact fallback: the fewest correctly rounded digits that read back as v */
+static void shortestExact(double v, char* buf, int& len, int& K)
+{
+	char tmp[NUMBER_BUFFER];
+
+	for (int precision = 1; ; ++precision)
+	{
+		snprintf(tmp, sizeof(tmp), "%.*e", precision - 1, v);
+		if (precision == 17 || strtod(tmp, NULL) == v)
+		{
+			break;
+		}
+	}
+
+	char* p = tmp;
+	len = 0;
+	for (; *p != 'e'; ++p)
+	{
+		if (isdigit((unsigned char)*p))
+		{
+			buf[len++] = *p;
+		}
+	}
+	while (len > 1 && buf[len - 1] == '0')
+	{
+		len--;
+	}
+	K = atoi(p + 1) - (len - 1);
+}
+
+static size_t writeExponent(int e, char* buf)
+{
+	size_t n = 0;
+	buf[n++] = e < 0 ? '-' : '+';
+	e = std::abs(e);
+	if (e >= 100)
+	{
+		buf[n++] = char('0' + e / 100);
+		e %= 100;
+		buf[n++] = char('0' + e / 10);
+	}
+	else if (e >= 10)
+	{
+		buf[n++] = char('0' + e / 10);
+	}
+	buf[n++] = char('0' + e % 10);
+	return n;
+}
+
+/* Lays out len digits with value digits * 10^K as Number::toString does */
+static size_t layout(char* buf, int len, int K)
+{
+	int n = len + K;
+
+	if (len <= n && n <= 21)
+	{
+		memset(buf + len, '0', n - len);
+		return n;
+	}
+	if (0 < n && n <= 21)
+	{
+		memmove(buf + n + 1, buf + n, len - n);
+		buf[n] = '.';
+		return len + 1;
+	}
+	if (-6 < n && n <= 0)
+	{
+		memmove(buf + 2 - n, buf, len);
+		buf[0] = '0';
+		buf[1] = '.';
+		memset(buf + 2, '0', -n);
+		return len + 2 - n;
+	}
+
+	size_t pos = 1;
+	if (len > 1)
+	{
+		memmove(buf + 2, buf + 1, len - 1);
+		buf[1] = '.';
+		pos = len + 1;
+	}
+	buf[pos++] = 'e';
+	return pos + writeExponent(n - 1, buf + pos);
+}
+
+static size_t writeInteger(uint64_t u, char* buf)
+{
+	char tmp[20];
+	size_t n = 0;
+	do
+	{
+		tmp[n++] = char('0' + u % 10);
+		u /= 10;
+	} while (u);
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		buf[i] = tmp[n - 1 - i];
+	}
+	return n;
+}
+
+size_t formatNumber(double d, char* buf)
+{
+	if (std::isnan(d))
+	{
+		memcpy(buf, "NaN", 3);
+		return 3;
+	}
+	if (d == 0)
+	{
+		buf[0] = '0';
+		return 1;
+	}
+
+	size_t sign = 0;
+	if (d < 0)
+	{
+		buf[sign++] = '-';
+		d = -d;
+	}
+
+	if (std::isinf(d))
+	{
+		memcpy(buf + sign, "Infinity", 8);
+		return sign + 8;
+	}
+	if (d < 9007199254740992.0 && d == std::floor(d))
+	{
+		return sign + writeInteger(uint64_t(d), buf + sign);
+	}
+
+	int len, K;
+	if (!grisu3(d, buf + sign, len, K))
+	{
+		shortestExact(d, buf + sign, len, K);
+	}
+	return sign + layout(buf + sign, len, K);
+}
+
+std::string formatNumber(double d)
+{
+	char buf[NUMBER_BUFFER];
+	return std::string(buf, formatNumber(d, buf));
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+double parseDecimal(const char* begin, const char* end, const char** stop)
+{
+	const char* p = begin;
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exp10 = 0;
+	bool any = false;
+	bool exact = true;
+
+	for (; p < end && *p == '0'; ++p)
+	{
+		any = true;
+	}
+	for (; p < end && isDigit(*p); ++p)
+	{
+		any = true;
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			digits++;
+		}
+		else
+		{
+			exp10++;
+			exact = exact && *p == '0';
+		}
+	}
+
+	if (p < end && *p == '.')
+	{
+		const char* q = p + 1;
+		bool frac = false;
+		if (digits == 0)
+		{
+			for (; q < end && *q == '0'; ++q)
+			{
+				exp10--;
+				frac = true;
+			}
+		}
+		for (; q < end && isDigit(*q); ++q)
+		{
+			frac = true;
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*q - '0');
+				digits++;
+				exp10--;
+			}
+			else
+			{
+				exact = exact && *q == '0';
+			}
+		}
+		if (any || frac)
+		{
+			any = true;
+			p = q;
+		}
+	}
+
+	if (!any)
+	{
+		*stop = begin;
+		return 0.0;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p + 1;
+		bool negative = false;
+		if (q < end && (*q == '+' || *q == '-'))
+		{
+			negative = *q == '-';
+			++q;
+		}
+		if (q < end && isDigit(*q))
+		{
+			int e = 0;
+			for (; q < end && isDigit(*q); ++q)
+			{
+				if (e < 100000)
+				{
+					e = e * 10 + (*q - '0');
+				}
+			}
+			exp10 += negative ? -e : e;
+			p = q;
+		}
+	}
+	*stop = p;
+
+	if (exact && mantissa == 0)
+	{
+		return 0.0;
+	}
+	if (exact && mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+	{
+		double m = double(mantissa);
+		return exp10 < 0 ? m / EXACT10[-exp10] : m * EXACT10[exp10];
+	}
+
+	std::string text(begin, p);
+	return std::strtod(text.c_str(), NULL);
+}
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static double parseRadix(const char* p, const char* end, int base)
+{
+	if (p == end)
+	{
+		return NAN;
+	}
+
+	double ret = 0.0;
+	for (; p < end; ++p)
+	{
+		char c = *p;
+		int d = isDigit(c) ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'z' ? (c | 0x20) - 'a' + 10 : base;
+		if (d >= base)
+		{
+			return NAN;
+		}
+		ret = ret * base + d;
+	}
+	return ret;
+}
+
+double stringToNumber(const std::string& s)
+{
+	const char* p = s.data();
+	const char* end = p + s.size();
+
+	while (p < end && isSpace(*p))
+	{
+		++p;
+	}
+	while (end > p && isSpace(end[-1]))
+	{
+		--end;
+	}
+	if (p == end)
+	{
+		return 0.0;
+	}
+
+	if (end - p > 1 && p[0] == '0')
+	{
+		switch (p[1] | 0x20)
+		{
+			case 'x':
+				return parseRadix(p + 2, end, 16);
+			case 'o':
+				return parseRadix(p + 2, end, 8);
+			case 'b':
+				return parseRadix(p + 2, end, 2);
+		}
+	}
+
+	bool negative = false;
+	if (*p == '+' || *p == '-')
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	double d;
+	if (end - p == 8 && memcmp(p, "Infinity", 8) == 0)
+	{
+		d = std::numeric_limits<double>::infinity();
+	}
+	else
+	{
+		const char* stop;
+		d = parseDecimal(p, end, &stop);
+		if (stop == p || stop != end)
+		{
+			return NAN;
+		}
+	}
+	return negative ? -d : d;
+}
+
+NAMESPACE_END
@@ -0,0 +1,56 @@
+#ifndef _NUMCONV_H_
+#define _NUMCONV_H_
+
+#include "common.h"
+
+NAMESPACE_BEGIN
+
+/*
+ * Number <-> text conversions with JS semantics. Formatting emits the
+ * shortest digit string that reads back to the same double, closest to
+ * it among equals (Grisu3, with an exact search for the values Grisu3
+ * cannot decide), and lays it out like Number.prototype.toString. Parsing converts exactly
+ * in a single multiply or divide when the digits allow it and defers to
+ * strtod otherwise.
+ */
+static const size_t NUMBER_BUFFER = 32;
+
+/* Writes the JS text for d into buf (NUMBER_BUFFER bytes); returns its length */
+size_t formatNumber(double d, char* buf);
+std::string formatNumber(double d);
+
+/*
+ * Reads a decimal literal (digits, optional fraction and exponent) from
+ * [begin, end) and stores where it stopped; stop == begin when there is
+ * no number.
+ */
+double parseDecimal(const char* begin, const char* end, const char** stop);
+
+/* ToNumber on a string: surrounding whitespace, radix prefixes, Infinity */
+double stringToNumber(const std::string& s);
+
+/* ToInt32: NaN and infinities become 0, everything else wraps mod 2^32 */
+inline int32_t wrap32(double d)
+{
+	if (!std::isfinite(d))
+	{
+		return 0;
+	}
+	double m = std::fmod(std::trunc(d), 4294967296.0);
+	return int32_t(uint32_t(m < 0 ? m + 4294967296.0 : m));
+}
+
+/* << and >> on ToInt32 operands; only the low five bits of the count matter */
+inline int32_t shiftLeft32(double a, double b)
+{
+	return int32_t(uint32_t(wrap32(a)) << (wrap32(b) & 31));
+}
+
+inline int32_t shiftRight32(double a, double b)
+{
+	return wrap32(a) >> (wrap32(b) & 31);
+}
+
+NAMESPACE_END
+
+#endif
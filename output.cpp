@@ -0,0 +1,122 @@
+#include "output.h"
+#include "vm.h"
+
+#include <cerrno>
+#include <unistd.h>
+
+NAMESPACE_BEGIN
+
+Output::Output(): sink_(Sink::FD), fd_(STDOUT_FILENO), callback_(NULL), ctx_(NULL),
+	limit_(DEFAULT_LIMIT)
+{}
+
+Output::~Output()
+{
+	flush();
+}
+
+void Output::toFd(int fd)
+{
+	flush();
+	sink_ = Sink::FD;
+	fd_ = fd;
+}
+
+void Output::toCallback(Callback callback, void* ctx)
+{
+	flush();
+	sink_ = Sink::CALLBACK;
+	callback_ = callback;
+	ctx_ = ctx;
+}
+
+void Output::toCapture()
+{
+	flush();
+	sink_ = Sink::CAPTURE;
+}
+
+void Output::setLimit(size_t bytes)
+{
+	limit_ = bytes;
+	if (buf_.length() >= limit_)
+	{
+		flush();
+	}
+}
+
+void Output::flush()
+{
+	if (buf_.empty())
+	{
+		return;
+	}
+
+	switch (sink_)
+	{
+		case Sink::FD:
+		{
+			const char* p = buf_.data();
+			size_t left = buf_.length();
+			while (left > 0)
+			{
+				ssize_t n = ::write(fd_, p, left);
+				if (n < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (n <= 0)
+				{
+					break;
+				}
+				p += n;
+				left -= n;
+			}
+			break;
+		}
+		case Sink::CALLBACK:
+			callback_(ctx_, buf_.data(), buf_.length());
+			break;
+		default:
+			captured_ += buf_;
+	}
+
+	buf_.clear();
+}
+
+static ValuePtr print(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	Output& out = vm->output();
+
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		if (i > 0)
+		{
+			out.write(" ", 1);
+		}
+		if (args[i]->type_ == Value::Type::STRING)
+		{
+			auto s = static_cast<StringValue*>(args[i].get());
+			out.write(s->data(), s->length());
+		}
+		else
+		{
+			out.write(args[i]->toString());
+		}
+	}
+	out.write("\n", 1);
+
+	return Undefined::instance();
+}
+
+void loadConsole(Scope* global)
+{
+	ValuePtr log(new NativeFunction("print", print));
+	ValuePtr console(new ObjectValue());
+
+	console->setAttr(atom("log"), log);
+	global->setVar(atom("console"), console);
+	global->setVar(atom("print"), log);
+}
+
+NAMESPACE_END
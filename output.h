@@ -0,0 +1,71 @@
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include "value.h"
+
+NAMESPACE_BEGIN
+
+/*
+ * Buffered script output behind console.log and print. Text collects in
+ * buf_ and reaches the sink once it passes limit_ bytes, on flush() and
+ * when the owning VM is destroyed. The host picks the sink: a file
+ * descriptor (stdout by default), a callback, or an in-memory capture.
+ */
+class Output {
+public:
+	typedef void (*Callback)(void* ctx, const char* data, size_t len);
+
+	enum Sink {
+		FD,
+		CALLBACK,
+		CAPTURE
+	};
+
+	static const size_t DEFAULT_LIMIT = 1 << 16;
+
+private:
+	Sink sink_;
+	int fd_;
+	Callback callback_;
+	void* ctx_;
+	std::string buf_;
+	std::string captured_;
+	size_t limit_;
+
+public:
+	Output();
+	~Output();
+
+	void toFd(int fd);
+	void toCallback(Callback callback, void* ctx);
+	void toCapture();
+	void setLimit(size_t bytes);
+
+	inline void write(const char* data, size_t len)
+	{
+		buf_.append(data, len);
+		if (buf_.length() >= limit_)
+		{
+			flush();
+		}
+	}
+	inline void write(const std::string& s)
+	{
+		write(s.data(), s.length());
+	}
+
+	void flush();
+
+	/* Everything written so far to a CAPTURE sink */
+	inline const std::string& captured()
+	{
+		flush();
+		return captured_;
+	}
+};
+
+void loadConsole(Scope* global);
+
+NAMESPACE_END
+
+#endif
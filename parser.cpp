@@ -4,6 +4,7 @@ NAMESPACE_BEGIN
 
 Parser::Parser(Lexer* lex) : root_(NULL), lex_(lex)
 {
+	boolConsts_[0] = boolConsts_[1] = -1;
 	lex_->restart();
 	root_ = program();
 }
@@ -47,6 +48,91 @@ bool Parser::expect(Token::Type type)
 	return (lex_->peek().type_ == type);
 }
 
+static double parseNumber(const std::string& data)
+{
+	int base = 10;
+	size_t i = 0;
+
+	if (data.length() > 1 && data[0] == '0')
+	{
+		switch (data[1])
+		{
+			case 'X':
+			case 'x':
+				base = 16;
+				i = 2;
+				break;
+			case 'B':
+			case 'b':
+				base = 2;
+				i = 2;
+				break;
+			case 'O':
+			case 'o':
+				base = 8;
+				i = 2;
+				break;
+			default:
+				if (data.find_first_not_of("01234567") == std::string::npos)
+				{
+					base = 8;
+					i = 1;
+				}
+		}
+	}
+
+	if (base == 10)
+	{
+		const char* stop;
+		return parseDecimal(data.data(), data.data() + data.length(), &stop);
+	}
+
+	double ret = 0.0;
+	for (; i < data.length(); ++i)
+	{
+		char c = data[i];
+		int d = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+		ret = ret * base + d;
+	}
+	return ret;
+}
+
+int Parser::constant(ValuePtr v)
+{
+	consts_.push_back(v);
+	return consts_.size() - 1;
+}
+
+int Parser::numberConstant(const std::string& data)
+{
+	double n = parseNumber(data);
+	auto r = numConsts_.find(n);
+	if (r != numConsts_.end())
+	{
+		return r->second;
+	}
+	return numConsts_[n] = constant(ValuePtr(new Number(n)));
+}
+
+int Parser::stringConstant(const std::string& str)
+{
+	auto r = strConsts_.find(str);
+	if (r != strConsts_.end())
+	{
+		return r->second;
+	}
+	return strConsts_[str] = constant(ValuePtr(new StringValue(str)));
+}
+
+int Parser::boolConstant(bool b)
+{
+	if (boolConsts_[b] < 0)
+	{
+		boolConsts_[b] = constant(ValuePtr(new Boolean(b)));
+	}
+	return boolConsts_[b];
+}
+
 Program* Parser::program()
 {
 	Scope* s = new Scope(NULL);
@@ -56,9 +142,80 @@ Program* Parser::program()
 	match(Token::Type::END_OF_FILE);
 	auto ret = new Program(PositionRange(begin, end), stmts);
 	ret->scope_ = s;
+	ret->consts_.swap(consts_);
+	ret->hoisted_.swap(hoisted_);
+	resolve();
 	return ret;
 }
 
+Identifier* Parser::reference(Identifier* id, bool declare)
+{
+	if (declare && id->scope_->getFrame())
+	{
+		id->scope_->getFrame()->declare(id->atom_);
+	}
+	refs_.push_back(id);
+	return id;
+}
+
+/*
+ * Binds every referenced name to a frame slot, an Env cell or the global
+ * scope chain. A local becomes a cell only when some inner function
+ * refers to it.
+ */
+void Parser::resolve()
+{
+	for (auto id : refs_)
+	{
+		FrameLayout* home = id->scope_->getFrame();
+		for (auto f = home; f; f = f->parent_)
+		{
+			auto r = f->locals_.find(id->atom_);
+			if (r != f->locals_.end())
+			{
+				if (f != home)
+				{
+					f->captured_[r->second] = true;
+				}
+				break;
+			}
+		}
+	}
+
+	for (auto f : frames_)
+	{
+		f->index_.resize(f->captured_.size());
+		for (size_t i = 0; i < f->captured_.size(); ++i)
+		{
+			f->index_[i] = f->captured_[i] ? f->ncells_++ : f->nslots_++;
+		}
+	}
+
+	for (auto id : refs_)
+	{
+		int depth = 0;
+		for (auto f = id->scope_->getFrame(); f; f = f->parent_)
+		{
+			auto r = f->locals_.find(id->atom_);
+			if (r != f->locals_.end())
+			{
+				id->binding_ = f->captured_[r->second] ?
+					Identifier::Binding::CELL : Identifier::Binding::SLOT;
+				id->index_ = f->index_[r->second];
+				id->depth_ = depth;
+				break;
+			}
+			if (f->ncells_)
+			{
+				depth++;
+			}
+		}
+	}
+
+	refs_.clear();
+	frames_.clear();
+}
+
 std::list<AST*>* Parser::topStatements(Scope* ps)
 {
 	auto ret = new std::list<AST*>();
@@ -90,9 +247,12 @@ AST* Parser::namedFunction(Scope* ps)
 	Position begin = lex_->peek().range_.begin_;
 
 	Scope* s = new Scope(ps);
+	auto layout = new FrameLayout(ps->getFrame());
+	s->setFrame(layout);
+	frames_.push_back(layout);
 
 	match("function");
-	auto name = identifier(ps);
+	auto name = reference(identifier(ps), true);
 	match("(");
 	auto plist = parameterList(s);
 	match(")");
@@ -104,6 +264,10 @@ AST* Parser::namedFunction(Scope* ps)
 
 	auto ret = new Function(PositionRange(begin, end), name, plist, stmts);
 	ret->scope_ = s;
+	ret->layout_ = layout;
+	ret->declaration_ = true;
+
+	(ps->getFrame() ? ps->getFrame()->hoisted_ : hoisted_).push_back(ret);
 
 	return ret;
 }
@@ -113,11 +277,11 @@ std::list<Identifier*>* Parser::parameterList(Scope* ps)
 	auto ret = new std::list<Identifier*>();
 	if (expect(Token::Type::IDENTIFIER))
 	{
-		ret->push_back(identifier(ps));
+		ret->push_back(reference(identifier(ps), true));
 		while (expect(","))
 		{
 			match(",");
-			ret->push_back(identifier(ps));
+			ret->push_back(reference(identifier(ps), true));
 		}
 	}
 	return ret;
@@ -248,7 +412,7 @@ Declaration* Parser::declare(Scope* ps)
 {
 	Position begin = lex_->peek().range_.begin_;
 
-	Identifier* id = identifier(ps);
+	Identifier* id = reference(identifier(ps), true);
 
 	AST* init = NULL;
 	if (expect("="))
@@ -460,7 +624,8 @@ AST* Parser::forStatement(Scope* ps)
 				throw ParseError(ss.str());
 			}
 
-			Identifier* id = new Identifier(*dynamic_cast<Identifier*>(*el->begin()));
+			Identifier* id = dynamic_cast<Identifier*>(*el->begin());
+			el->clear();
 			deletePtr(init);
 			init = id;
 
@@ -841,11 +1006,13 @@ AST* Parser::primary(Scope* ps)
 	}
 	else if (expect(Token::Type::IDENTIFIER))
 	{
-		return identifier(ps);
+		return reference(identifier(ps), false);
 	}
 	else if (expect("true") || expect("false"))
 	{
-		return new LiteralBool(lex_->get());
+		auto ret = new LiteralBool(lex_->get());
+		ret->const_ = boolConstant(ret->b_);
+		return ret;
 	}
 	else if (expect("null"))
 	{
@@ -853,16 +1020,24 @@ AST* Parser::primary(Scope* ps)
 	}
 	else if (expect(Token::Type::STRING))
 	{
-		return new LiteralString(lex_->get());
+		auto ret = new LiteralString(lex_->get());
+		ret->const_ = stringConstant(ret->str_);
+		return ret;
 	}
 	else if (expect(Token::Type::NUMBER))
 	{
-		return new LiteralNumber(lex_->get());
+		auto ret = new LiteralNumber(lex_->get());
+		ret->const_ = numberConstant(ret->data_);
+		return ret;
 	}
 	else if (expect("this") || expect("arguments"))
 	{
 		auto ret = new Keyword(lex_->get());
 		ret->scope_ = ps;
+		if (ps->getFrame() && ret->data_ == "arguments")
+		{
+			ps->getFrame()->arguments_ = true;
+		}
 		return ret;
 	}
 	else if (expect("["))
@@ -895,11 +1070,14 @@ Function* Parser::function(Scope* ps)
 	match("function");
 
 	Scope* s = new Scope(ps);
+	auto layout = new FrameLayout(ps->getFrame());
+	s->setFrame(layout);
+	frames_.push_back(layout);
 
 	Identifier* name = NULL;
 	if (expect(Token::Type::IDENTIFIER))
 	{
-		name = identifier(ps);
+		name = reference(identifier(s), true);
 	}
 	match("(");
 	auto plist = parameterList(s);
@@ -912,6 +1090,7 @@ Function* Parser::function(Scope* ps)
 
 	auto ret = new Function(PositionRange(begin, end), name, plist, stmts);
 	ret->scope_ = s;
+	ret->layout_ = layout;
 
 	return ret;
 }
@@ -971,7 +1150,7 @@ Object* Parser::literalObject(Scope* ps)
 	{
 		for (;;)
 		{
-			AST* key = primary(ps);
+			AST* key = expect(Token::Type::IDENTIFIER) ? identifier(ps) : primary(ps);
 
 			match(":");
 
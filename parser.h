@@ -76,6 +76,13 @@ class Parser {
 private:
 	Program* root_;
 	Lexer* lex_;
+	std::vector<ValuePtr> consts_;
+	std::unordered_map<std::string, int> strConsts_;
+	std::unordered_map<double, int> numConsts_;
+	int boolConsts_[2];
+	std::vector<Identifier*> refs_;
+	std::vector<FrameLayout*> frames_;
+	std::list<Function*> hoisted_;
 
 	Token match(std::string s);
 	Token match(Token::Type type);
@@ -89,6 +96,14 @@ private:
 	AST* statement(Scope* ps);
 	void opteol();
 
+	int constant(ValuePtr v);
+	int numberConstant(const std::string& data);
+	int stringConstant(const std::string& str);
+	int boolConstant(bool b);
+
+	Identifier* reference(Identifier* id, bool declare);
+	void resolve();
+
 	Program* program();
 	AST* ifStatement(Scope* s);
 	AST* switchStatement(Scope* s);
@@ -0,0 +1,189 @@
+#include "profiler.h"
+
+#include <ctime>
+#include <mutex>
+
+NAMESPACE_BEGIN
+
+std::atomic<int> Profiler::ticks_(0);
+
+/* The shared timer and the number of profilers using it */
+static std::mutex timerLock;
+static int running = 0;
+static timer_t timer;
+
+void Profiler::tick(int sig)
+{
+	ticks_.fetch_add(1, std::memory_order_relaxed);
+}
+
+Profiler::~Profiler()
+{
+	stop();
+}
+
+void Profiler::start(int hz)
+{
+	if (active_)
+	{
+		return;
+	}
+
+	active_ = true;
+	seen_ = ticks_.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> l(timerLock);
+	if (running++ == 0)
+	{
+		int signo = SIGRTMIN + 1;
+
+		struct sigaction sa;
+		sa.sa_handler = tick;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		sigaction(signo, &sa, NULL);
+
+		struct sigevent ev = {};
+		ev.sigev_notify = SIGEV_SIGNAL;
+		ev.sigev_signo = signo;
+		timer_create(CLOCK_PROCESS_CPUTIME_ID, &ev, &timer);
+
+		struct itimerspec spec = {};
+		spec.it_interval.tv_nsec = 1000000000L / std::max(1, std::min(hz, 100000));
+		spec.it_value = spec.it_interval;
+		timer_settime(timer, 0, &spec, NULL);
+	}
+}
+
+void Profiler::stop()
+{
+	if (!active_)
+	{
+		return;
+	}
+
+	active_ = false;
+
+	std::lock_guard<std::mutex> l(timerLock);
+	if (--running == 0)
+	{
+		timer_delete(timer);
+	}
+}
+
+std::string functionName(Function* func)
+{
+	if (func == NULL)
+	{
+		return "(program)";
+	}
+	if (func->id_)
+	{
+		return func->id_->name_;
+	}
+	return "anonymous@" + std::to_string(func->range_.begin_.line_);
+}
+
+static void label(std::string& out, Function* func, int line)
+{
+	out += functionName(func);
+	out += ":" + std::to_string(line);
+}
+
+void Profiler::sample(Frame* top, AST* at)
+{
+	seen_ = ticks_.load(std::memory_order_relaxed);
+	samples_++;
+
+	std::vector<std::pair<Function*, int>> frames;
+	int line = at->range_.begin_.line_;
+
+	for (Frame* f = top; f; f = f->caller_)
+	{
+		frames.push_back(std::make_pair(f->func_, line));
+		line = f->site_ ? f->site_->range_.begin_.line_ : 0;
+	}
+	frames.push_back(std::make_pair((Function*)NULL, line));
+
+	std::string stack;
+	for (auto i = frames.rbegin(); i != frames.rend(); ++i)
+	{
+		if (!stack.empty())
+		{
+			stack += ";";
+		}
+		label(stack, i->first, i->second);
+	}
+
+	stacks_[stack]++;
+}
+
+void Profiler::write(std::ostream& out)
+{
+	for (auto& s : stacks_)
+	{
+		out << s.first << " " << s.second << "\n";
+	}
+}
+
+void CallProfile::start(const std::string& path)
+{
+	active_ = true;
+	path_ = path;
+	startCycles_ = now();
+	startTime_ = std::chrono::steady_clock::now();
+}
+
+void CallProfile::stop()
+{
+	active_ = false;
+}
+
+void CallProfile::leave(Frame* f)
+{
+	uint64_t inclusive = now() - f->start_;
+	CallStats& s = stats_[f->func_];
+
+	s.calls_++;
+	s.args_ += f->argc_;
+	s.inclusive_ += inclusive;
+	s.exclusive_ += inclusive - std::min(inclusive, f->children_);
+
+	if (f->caller_)
+	{
+		f->caller_->children_ += inclusive;
+	}
+}
+
+double CallProfile::cyclesPerSecond()
+{
+	double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+	return secs > 0 ? (now() - startCycles_) / secs : 1e9;
+}
+
+void CallProfile::write(std::ostream& out)
+{
+	std::vector<std::pair<Function*, CallStats>> rows(stats_.begin(), stats_.end());
+	std::sort(rows.begin(), rows.end(),
+		[](const std::pair<Function*, CallStats>& a, const std::pair<Function*, CallStats>& b) {
+			return a.second.exclusive_ > b.second.exclusive_;
+		});
+
+	double ms = 1000.0 / cyclesPerSecond();
+	char buf[256];
+
+	out << "[";
+	for (size_t i = 0; i < rows.size(); ++i)
+	{
+		const CallStats& s = rows[i].second;
+		snprintf(buf, sizeof(buf), "\"line\":%d,\"calls\":%llu,\"avg_args\":%.2f,"
+			"\"inclusive_ms\":%.3f,\"exclusive_ms\":%.3f}",
+			rows[i].first->range_.begin_.line_, (unsigned long long)s.calls_,
+			s.calls_ ? double(s.args_) / s.calls_ : 0.0,
+			s.inclusive_ * ms, s.exclusive_ * ms);
+		out << (i ? ",\n " : "\n ") << "{\"function\":\"" << functionName(rows[i].first) << "\"," << buf;
+	}
+	out << "\n]\n";
+}
+
+NAMESPACE_END
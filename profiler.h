@@ -0,0 +1,122 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "value.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+NAMESPACE_BEGIN
+
+/*
+ * Sampling profiler over script stacks. A timer on the process CPU clock
+ * raises a real-time signal (SIGPROF stays with gprof builds) whose
+ * handler only bumps ticks_. Each profiling VM takes one sample per tick
+ * at its next safepoint in VM::exec(AST*), where the frame chain is
+ * consistent. A sample names every active function with its current
+ * line, outermost first, and samples aggregate as collapsed stacks for
+ * flamegraph.pl. VMs on any number of threads may profile at once: the
+ * timer is shared, created by the first profiler to start and deleted
+ * by the last to stop, and the tick count is a lock-free atomic.
+ * Each output line is one stack followed by its sample count:
+ *   (program):12;render:40;anonymous@7:9 31
+ */
+class Profiler {
+public:
+	static const int DEFAULT_HZ = 997;
+
+private:
+	static std::atomic<int> ticks_;
+
+	bool active_;
+	int seen_;
+	uint64_t samples_;
+	std::unordered_map<std::string, uint64_t> stacks_;
+
+	static void tick(int sig);
+
+public:
+	Profiler(): active_(false), seen_(0), samples_(0)
+	{}
+	~Profiler();
+
+	void start(int hz = DEFAULT_HZ);
+	void stop();
+
+	inline bool due()
+	{
+		return active_ && seen_ != ticks_.load(std::memory_order_relaxed);
+	}
+	void sample(Frame* top, AST* at);
+
+	inline uint64_t samples() { return samples_; }
+	void write(std::ostream& out);
+};
+
+struct CallStats {
+	uint64_t calls_;
+	uint64_t args_;
+	uint64_t inclusive_;
+	uint64_t exclusive_;
+
+	CallStats(): calls_(0), args_(0), inclusive_(0), exclusive_(0)
+	{}
+};
+
+/*
+ * Opt-in exact counters per script Function: calls, arguments passed and
+ * cycle-counter time. A callee's inclusive cycles are charged to its
+ * caller's children_, so exclusive time excludes nested script calls
+ * (recursion counts inclusive time once per activation). Cycles convert
+ * to seconds against the steady clock over the measured interval. With
+ * a dump path set, the VM writes the JSON report when it is destroyed.
+ */
+class CallProfile {
+private:
+	bool active_;
+	std::string path_;
+	std::unordered_map<Function*, CallStats> stats_;
+	uint64_t startCycles_;
+	std::chrono::steady_clock::time_point startTime_;
+
+public:
+	CallProfile(): active_(false), startCycles_(0)
+	{}
+
+	static inline uint64_t now()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	void start(const std::string& path = "");
+	void stop();
+
+	inline bool active() { return active_; }
+	inline const std::string& path() { return path_; }
+
+	inline void enter(Frame* f)
+	{
+		f->start_ = now();
+	}
+	void leave(Frame* f);
+
+	inline const std::unordered_map<Function*, CallStats>& stats() { return stats_; }
+	double cyclesPerSecond();
+	void write(std::ostream& out);
+};
+
+std::string functionName(Function* func);
+
+NAMESPACE_END
+
+#endif
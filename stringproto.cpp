@@ -0,0 +1,213 @@
+#include "stringproto.h"
+#include "vm.h"
+
+#include <cstring>
+
+NAMESPACE_BEGIN
+
+static ValuePtr arg(const std::vector<ValuePtr>& args, size_t i)
+{
+	return i < args.size() ? args[i] : Undefined::instance();
+}
+
+static ValuePtr receiver(const ValuePtr& self)
+{
+	if (self == nullptr || self->type_ == Value::Type::UNDEFINED
+		|| self->type_ == Value::Type::NULLVAL)
+	{
+		throw ExecError("String.prototype method called on null or undefined");
+	}
+	if (self->type_ == Value::Type::STRING)
+	{
+		return self;
+	}
+	return ValuePtr(new StringValue(self->toString()));
+}
+
+/* ToIntegerOrInfinity clamped to [0, length]; negative counts from the end if relative */
+static size_t position(const ValuePtr& v, size_t length, bool relative, size_t missing)
+{
+	if (v->type_ == Value::Type::UNDEFINED)
+	{
+		return missing;
+	}
+
+	double d = v->toNumber();
+	if (std::isnan(d))
+	{
+		return 0;
+	}
+	d = std::trunc(d);
+	if (relative && d < 0)
+	{
+		d += length;
+	}
+	return d <= 0 ? 0 : d >= length ? length : size_t(d);
+}
+
+static ValuePtr charAt(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto s = receiver(self);
+	auto str = static_cast<StringValue*>(s.get());
+	double i = std::trunc(arg(args, 0)->toNumber());
+
+	if (std::isnan(i))
+	{
+		i = 0;
+	}
+	if (i < 0 || i >= str->length())
+	{
+		return ValuePtr(new StringValue(""));
+	}
+	return StringValue::character(str->data()[size_t(i)]);
+}
+
+static ValuePtr charCodeAt(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto s = receiver(self);
+	auto str = static_cast<StringValue*>(s.get());
+	double i = std::trunc(arg(args, 0)->toNumber());
+
+	if (std::isnan(i))
+	{
+		i = 0;
+	}
+	if (i < 0 || i >= str->length())
+	{
+		return NotaNumber::instance();
+	}
+	return ValuePtr(new Number(int32_t(uint8_t(str->data()[size_t(i)]))));
+}
+
+static ValuePtr substring(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto s = receiver(self);
+	size_t length = static_cast<StringValue*>(s.get())->length();
+	size_t begin = position(arg(args, 0), length, false, 0);
+	size_t end = position(arg(args, 1), length, false, length);
+
+	if (begin > end)
+	{
+		std::swap(begin, end);
+	}
+	return StringValue::slice(s, begin, end);
+}
+
+static ValuePtr slice(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto s = receiver(self);
+	size_t length = static_cast<StringValue*>(s.get())->length();
+	size_t begin = position(arg(args, 0), length, true, 0);
+	size_t end = position(arg(args, 1), length, true, length);
+
+	return StringValue::slice(s, begin, std::max(begin, end));
+}
+
+static size_t find(StringValue* str, const ValuePtr& pattern, size_t from)
+{
+	auto p = static_cast<StringValue*>(pattern.get());
+	size_t n = p->length();
+	size_t length = str->length();
+
+	if (n == 0)
+	{
+		return from;
+	}
+
+	const char* data = str->data();
+	const char* needle = p->data();
+
+	while (from + n <= length)
+	{
+		auto hit = static_cast<const char*>(memchr(data + from, needle[0], length - n + 1 - from));
+		if (hit == NULL)
+		{
+			break;
+		}
+		from = hit - data;
+		if (memcmp(hit, needle, n) == 0)
+		{
+			return from;
+		}
+		from++;
+	}
+	return std::string::npos;
+}
+
+static ValuePtr indexOf(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto s = receiver(self);
+	auto str = static_cast<StringValue*>(s.get());
+	auto pattern = receiver(arg(args, 0)->type_ == Value::Type::UNDEFINED
+		? ValuePtr(new StringValue("undefined")) : arg(args, 0));
+	size_t r = find(str, pattern, position(arg(args, 1), str->length(), false, 0));
+
+	return ValuePtr(new Number(r == std::string::npos ? int32_t(-1) : int32_t(r)));
+}
+
+static ValuePtr split(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto s = receiver(self);
+	auto str = static_cast<StringValue*>(s.get());
+	auto ret = new ArrayValue();
+	ValuePtr arr(ret);
+
+	uint32_t limit = UINT32_MAX;
+	if (arg(args, 1)->type_ != Value::Type::UNDEFINED)
+	{
+		double d = arg(args, 1)->toNumber();
+		limit = std::isfinite(d) ? uint32_t(int64_t(d)) : 0;
+	}
+	if (limit == 0)
+	{
+		return arr;
+	}
+
+	if (arg(args, 0)->type_ == Value::Type::UNDEFINED)
+	{
+		ret->push(s);
+		return arr;
+	}
+
+	auto sep = receiver(arg(args, 0));
+	size_t n = static_cast<StringValue*>(sep.get())->length();
+	size_t length = str->length();
+
+	if (n == 0)
+	{
+		const char* data = str->data();
+		for (size_t i = 0; i < length && ret->length() < limit; ++i)
+		{
+			ret->push(StringValue::character(data[i]));
+		}
+		return arr;
+	}
+
+	size_t begin = 0;
+	while (ret->length() < limit)
+	{
+		size_t hit = find(str, sep, begin);
+		if (hit == std::string::npos)
+		{
+			ret->push(StringValue::slice(s, begin, length));
+			break;
+		}
+		ret->push(StringValue::slice(s, begin, hit));
+		begin = hit + n;
+	}
+	return arr;
+}
+
+void loadStrings()
+{
+	auto proto = static_cast<ObjectLike*>(Value::prototype(Value::Type::STRING).get());
+
+	proto->attr_[atom("charAt")] = ValuePtr(new NativeFunction("charAt", charAt));
+	proto->attr_[atom("charCodeAt")] = ValuePtr(new NativeFunction("charCodeAt", charCodeAt));
+	proto->attr_[atom("indexOf")] = ValuePtr(new NativeFunction("indexOf", indexOf));
+	proto->attr_[atom("slice")] = ValuePtr(new NativeFunction("slice", slice));
+	proto->attr_[atom("split")] = ValuePtr(new NativeFunction("split", split));
+	proto->attr_[atom("substring")] = ValuePtr(new NativeFunction("substring", substring));
+}
+
+NAMESPACE_END
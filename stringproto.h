@@ -0,0 +1,17 @@
+#ifndef _STRINGPROTO_H_
+#define _STRINGPROTO_H_
+
+#include "value.h"
+
+NAMESPACE_BEGIN
+
+/*
+ * String.prototype methods. Results that are pieces of the receiver are
+ * built with StringValue::slice and StringValue::character, so they share
+ * its buffer instead of copying.
+ */
+void loadStrings();
+
+NAMESPACE_END
+
+#endif
@@ -1,7 +1,11 @@
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "vm.h"
+#include "heapsnapshot.h"
 
 using namespace cl;
 using namespace std;
@@ -16,14 +20,120 @@ void displayLexer(Lexer* lex)
 	}
 }
 
+void displayGlobals(Program* prog)
+{
+	for (auto i : prog->scope_->getValueMap())
+	{
+		cout << "var: " << atomName(i.first)
+			<< " == " << i.second->toString() << endl;
+	}
+}
+
+/* Interrupts the VM if the script is still running after ms milliseconds */
+class Watchdog {
+private:
+	std::mutex lock_;
+	std::condition_variable done_;
+	bool finished_;
+	std::thread thread_;
+
+public:
+	Watchdog(VM* vm, long ms): finished_(false)
+	{
+		thread_ = std::thread([this, vm, ms]() {
+			std::unique_lock<std::mutex> l(lock_);
+			if (!done_.wait_for(l, std::chrono::milliseconds(ms), [this]() { return finished_; }))
+			{
+				vm->budget().interrupt();
+			}
+		});
+	}
+	~Watchdog()
+	{
+		{
+			std::lock_guard<std::mutex> l(lock_);
+			finished_ = true;
+		}
+		done_.notify_one();
+		thread_.join();
+	}
+};
+
 int main(int argc, char const *argv[])
 {
-	if (argc != 2)
+	bool dump = false;
+	const char* profile = NULL;
+	const char* calls = NULL;
+	const char* allocs = NULL;
+	int allocRate = 1;
+	const char* heap = NULL;
+	const char* retainers = NULL;
+	size_t memoryLimit = 0;
+	long long steps = 0;
+	long timeout = 0;
+	size_t outputLimit = 0;
+	const char* script = NULL;
+
+	for (int i = 1; i < argc; ++i)
 	{
+		if (string(argv[i]) == "-d")
+		{
+			dump = true;
+		}
+		else if (string(argv[i]) == "-p" && i + 1 < argc)
+		{
+			profile = argv[++i];
+		}
+		else if (string(argv[i]) == "-c" && i + 1 < argc)
+		{
+			calls = argv[++i];
+		}
+		else if (string(argv[i]) == "-a" && i + 1 < argc)
+		{
+			allocs = argv[++i];
+		}
+		else if (string(argv[i]) == "-s" && i + 1 < argc)
+		{
+			allocRate = atoi(argv[++i]);
+		}
+		else if (string(argv[i]) == "-H" && i + 1 < argc)
+		{
+			heap = argv[++i];
+		}
+		else if (string(argv[i]) == "-R" && i + 1 < argc)
+		{
+			retainers = argv[++i];
+		}
+		else if (string(argv[i]) == "-M" && i + 1 < argc)
+		{
+			memoryLimit = strtoull(argv[++i], NULL, 10);
+		}
+		else if (string(argv[i]) == "-S" && i + 1 < argc)
+		{
+			steps = atoll(argv[++i]);
+		}
+		else if (string(argv[i]) == "-T" && i + 1 < argc)
+		{
+			timeout = atol(argv[++i]);
+		}
+		else if (string(argv[i]) == "-O" && i + 1 < argc)
+		{
+			outputLimit = strtoull(argv[++i], NULL, 10);
+		}
+		else
+		{
+			script = argv[i];
+		}
+	}
+
+	if (script == NULL)
+	{
+		cerr << "usage: " << argv[0] << " [-d] [-p profile.folded] [-c calls.json] [-a allocs.txt [-s rate]]"
+			<< " [-H heap.heapsnapshot] [-R retainers.txt] [-M bytes] [-S steps] [-T ms] [-O bytes] script.js" << endl;
 		return 1;
 	}
 
-	ifstream f(argv[1]);
+	ifstream f(script);
 	string source;
 	char buf[4096];
 	size_t rb;
@@ -44,7 +154,84 @@ int main(int argc, char const *argv[])
 
 	auto vm = new VM();
 
-	vm->exec(ps->getProgram());
+	if (outputLimit)
+	{
+		vm->output().setLimit(outputLimit);
+	}
+
+	if (profile)
+	{
+		vm->profiler().start();
+	}
+
+	if (calls)
+	{
+		vm->calls().start(calls);
+	}
+
+	if (allocs)
+	{
+		vm->allocs().start(allocRate);
+	}
+
+	vm->memory().setLimit(memoryLimit);
+
+	if (steps > 0)
+	{
+		vm->budget().reset(steps);
+	}
+
+	int status = 0;
+
+	try
+	{
+		std::unique_ptr<Watchdog> watchdog(timeout > 0 ? new Watchdog(vm, timeout) : NULL);
+		vm->exec(ps->getProgram());
+	}
+	catch (std::exception& e)
+	{
+		vm->output().flush();
+		cerr << e.what() << endl;
+		status = 1;
+	}
+
+	vm->output().flush();
+
+	if (profile)
+	{
+		vm->profiler().stop();
+		ofstream out(profile);
+		vm->profiler().write(out);
+	}
+
+	if (allocs)
+	{
+		vm->allocs().stop();
+		ofstream out(allocs);
+		vm->allocs().write(out);
+	}
+
+	if (heap || retainers)
+	{
+		HeapSnapshot snap(vm);
+		if (heap)
+		{
+			ofstream out(heap);
+			snap.write(out);
+		}
+		if (retainers)
+		{
+			ofstream out(retainers);
+			snap.writeSummary(out);
+		}
+	}
+
+	if (dump)
+	{
+		displayGlobals(ps->getProgram());
+	}
+
+	delete vm;
 
-	return 0;
+	return status;
 }
\ No newline at end of file
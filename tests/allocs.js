@@ -0,0 +1,25 @@
+// Run with the allocation report. As many object literals with three
+// properties as empty ones must rank above them, by the property map
+// charged to each object and not to its node; likewise string payloads
+// belong to the strings, including a payload that slice allocates before
+// its string value. Growing an array or an object's properties through
+// a store has no value to charge, so it shows as internal blocks of the
+// assignment.
+var empty = [], full = [], names = [], tails = [], i;
+for (i = 0; i < 100; i++) {
+	empty[i] = {};
+}
+for (i = 0; i < 100; i++) {
+	full[i] = { a: i, b: i, c: i };
+}
+for (i = 0; i < 100; i++) {
+	names[i] = "item " + i;
+}
+for (i = 0; i < 100; i++) {
+	tails[i] = names[i].slice(2) + " and the rest of a longer string";
+}
+var o = {};
+for (i = 0; i < 100; i++) {
+	o["k" + i] = i;
+}
+print(tails[99]);
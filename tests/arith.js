@@ -0,0 +1,7 @@
+// The int32 fast paths must give way to doubles whenever the result is -0.
+function sign(x) { return x === 0 ? (1 / x > 0 ? "+0" : "-0") : x; }
+
+var a = -4, b = 2, c = -1, d = 7, z = 0, m = -2147483648;
+print("mod", sign(a % b), sign(a % c), sign(m % c), sign(d % c), sign(z % c), sign(z % b), sign(-7 % 3), sign(d % -3));
+print("mul", sign(z * c), sign(a * z), sign(b * d), sign(z * z));
+print("div", sign(z / c), sign(a / b), sign(z / b), sign(d / b));
@@ -0,0 +1,23 @@
+// Run with a budget of 701 steps: a step is a loop iteration, traced or
+// not, or a call. The 700 steps up to the second print fit exactly, so
+// a loop or call left uncounted would not change the output, but one
+// counted twice would; the endless loop then runs out of budget and the
+// script stops with the output so far.
+var n = 0, i;
+for (i = 0; i < 500; i++) {
+	n++;
+}
+print(n);
+
+function one() {
+	return 1;
+}
+for (i = 0; i < 100; i++) {
+	n += one();
+}
+print(n);
+
+while (true) {
+	n++;
+}
+print("never printed");
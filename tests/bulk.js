@@ -0,0 +1,124 @@
+// Typed-array bulk methods against plain loops, at lengths around every
+// vector width and on views that start one element into their buffer,
+// with guard elements on both sides. run.sh repeats this at each CL_BULK
+// level, so the SSE2 and AVX2 kernels must match the scalar ones.
+var kinds = [Float64Array, Int32Array, Uint8Array];
+var names = ["Float64Array", "Int32Array", "Uint8Array"];
+
+// Distinct for the first 1013 indices, so each extreme sits in one lane
+function value(k, i, seed) {
+	var v = (i * 389 + seed * 101) % 1013 - 506;
+	if (k === 0) {
+		return i % 11 === 5 ? 0 / 0 : v * 0.5;
+	}
+	if (k === 1) {
+		return v * 2053;
+	}
+	return v & 255;
+}
+
+function wrap(k, v) {
+	if (k === 1) {
+		return v | 0;
+	}
+	if (k === 2) {
+		return v & 255;
+	}
+	return v;
+}
+
+function same(a, b) {
+	return a === b || (a !== a && b !== b);
+}
+
+var lengths = [];
+for (var n = 0; n <= 40; n++) {
+	lengths[lengths.length] = n;
+}
+lengths[lengths.length] = 63;
+lengths[lengths.length] = 64;
+lengths[lengths.length] = 65;
+lengths[lengths.length] = 1001;
+
+for (var k = 0; k < kinds.length; k++) {
+	var Ctor = kinds[k];
+	var checks = 0, failures = 0;
+
+	for (var li = 0; li < lengths.length; li++) {
+		for (var offset = 0; offset < 2; offset++) {
+			var n = lengths[li];
+			var size = k === 0 ? 8 : k === 1 ? 4 : 1;
+			var whole = new Ctor(n + 2 + offset);
+			var a = new Ctor(whole.buffer, (offset + 1) * size, n);
+			var b = new Ctor(n);
+			var i;
+
+			whole[offset] = 99;
+			whole[n + 1 + offset] = 99;
+
+			for (i = 0; i < n; i++) {
+				a[i] = value(k, i, 1);
+				b[i] = value(k, i, 2);
+			}
+
+			// min and max skip NaN, which only the Float64Array holds; the
+			// sum is checked once it is gone
+			var lo = 1 / 0, hi = -1 / 0;
+			for (i = 0; i < n; i++) {
+				lo = a[i] < lo ? a[i] : lo;
+				hi = a[i] > hi ? a[i] : hi;
+			}
+			var got = [a.min(), a.max()];
+			var want = [lo, hi];
+
+			var sum = 0;
+			for (i = 0; i < n; i++) {
+				if (a[i] !== a[i]) {
+					a[i] = 0;
+				}
+				sum += a[i];
+			}
+			got[2] = a.sum();
+			want[2] = sum;
+
+			for (i = 0; i < 3; i++) {
+				checks++;
+				if (!same(got[i], want[i])) {
+					failures++;
+					print(names[k] + " n=" + n + " offset=" + offset + " reduce " + i + ": " + got[i] + " != " + want[i]);
+				}
+			}
+
+			var sums = [], products = [];
+			for (i = 0; i < n; i++) {
+				sums[i] = wrap(k, a[i] + b[i]);
+				products[i] = wrap(k, a[i] * b[i]);
+			}
+			var c = new Ctor(a);
+			a.add(b);
+			c.mul(b);
+			for (i = 0; i < n; i++) {
+				checks += 2;
+				if (!same(a[i], sums[i]) || !same(c[i], products[i])) {
+					failures++;
+					print(names[k] + " n=" + n + " offset=" + offset + " at " + i + ": " + a[i] + " " + c[i]);
+				}
+			}
+
+			a.fill(k === 0 ? 2.5 : 77);
+			for (i = 0; i < n; i++) {
+				checks++;
+				if (a[i] !== (k === 0 ? 2.5 : 77)) {
+					failures++;
+				}
+			}
+			checks++;
+			if (whole[offset] !== 99 || whole[n + 1 + offset] !== 99) {
+				failures++;
+				print(names[k] + " n=" + n + " offset=" + offset + ": guard overwritten");
+			}
+		}
+	}
+
+	print(names[k] + " " + checks + " checks, " + failures + " failures");
+}
@@ -0,0 +1,34 @@
+// Run with the calls report: each function's call count and average
+// argument count, for declared, anonymous, recursive and method calls,
+// with fewer or more arguments than parameters.
+function add(a, b) {
+	return a + b;
+}
+
+function fib(n) {
+	return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+var twice = function (f, x) {
+	return f(f(x));
+};
+
+var point = {
+	x: 3,
+	norm: function () {
+		return this.x * this.x;
+	}
+};
+
+var s = 0, i;
+for (i = 0; i < 10; i++) {
+	s = add(s, i);
+}
+for (i = 0; i < 5; i++) {
+	s = add(s, i, i, i);
+}
+print(s);
+print(fib(10));
+print(twice(function (v) { return v * 3; }, 2));
+print(point.norm() + point.norm());
+print(add(1));
@@ -0,0 +1,18 @@
+// Objects, arrays and functions compare by identity; only strings by content
+var o = {};
+var a = [1, 2];
+var f = function () {};
+var g = function () {};
+
+print(({}) === ({}));
+print(o === o);
+print(o !== {});
+print([1, 2] == [1, 2]);
+print(a == a);
+print(a === a);
+print(f == g);
+print(f === f);
+print(o == a);
+print("1,2" == a);
+print("ab" === "a" + "b");
+print("ab" != "a" + "b");
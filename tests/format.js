@@ -0,0 +1,28 @@
+// Numbers print with the fewest digits that read back to the same double,
+// the closest such digits when several qualify, laid out as
+// Number.prototype.toString does.
+var values = [
+	140865.72066115701,
+	-34077362267111672,
+	0.1 + 0.2,
+	1 / 3,
+	2 / 3,
+	5e-324,
+	2.2250738585072014e-308,
+	1.7976931348623157e308,
+	9007199254740993,
+	123456789012345680000,
+	1e21,
+	1.5e-7,
+	0.000001,
+	-0.0000015,
+	4.35,
+	0.3,
+	2.675,
+	1e23,
+	9.5367431640625e-7,
+	5.764607523034235e39
+];
+for (var i = 0; i < values.length; i++) {
+	print(values[i]);
+}
@@ -0,0 +1,6 @@
+// Typed arrays and their buffers top the retainers summary under the
+// variables that hold them.
+var samples = new Float64Array(100000);
+var counts = new Int32Array(50000);
+var bytes = new Uint8Array(150000);
+print(samples.length + counts.length + bytes.length);
@@ -0,0 +1,36 @@
+// Computed property names are looked up, not interned, and must agree
+// with the same names written as identifiers
+var o = {};
+o["fo" + "o"] = 1;
+o.bar = 2;
+print(o.foo + o["b" + "ar"]);
+
+var n = 0;
+for (var i = 0; i < 20000; i++) {
+	o["k" + i] = i;
+	n += o["k" + i];
+	delete o["k" + i];
+}
+print(n);
+print(o["k" + 5]);
+
+var p = { "x y": 3 };
+p["x" + " y"] += 4;
+print(p["x y"]);
+
+var a = [];
+a[10] = "near";
+a[50000] = "far";
+print(a.length + " " + a[50000] + " " + a["5000" + "0"]);
+a.length = 100;
+print(a[50000]);
+
+var count = 0;
+var q = {};
+q["b" + 1] = 1;
+q.a = 2;
+q["c" + 2] = 3;
+for (var v in q) {
+	count++;
+}
+print(count);
@@ -0,0 +1,22 @@
+// console.log and print share one buffer. run.sh shrinks it to 16 bytes
+// so that it flushes mid-line, and the script then fails: every line
+// written before the error must come out, in order, ahead of the error
+// message.
+console.log("first", 1, true);
+print("second line is longer than the sixteen byte buffer");
+console.log();
+for (var i = 0; i < 5; i++) {
+	if (i % 2) {
+		print("print", i);
+	} else {
+		console.log("log", i, [i, i + 1], {});
+	}
+}
+var s = "x";
+for (var j = 0; j < 6; j++) {
+	s = s + s;
+}
+console.log(s.length, s);
+print("last before the error");
+missing();
+print("never printed");
@@ -0,0 +1,13 @@
+// Profiler smoke test: samples land on if statements without an else
+function count(n) {
+	var odd = 0;
+	for (var i = 0; i < n; i++) {
+		if (i % 2) { odd++; }
+	}
+	return odd;
+}
+var total = 0;
+for (var r = 0; r < 40; r++) {
+	total += count(1000);
+}
+print(total);
@@ -0,0 +1,81 @@
+#!/bin/sh
+# Runs each tests/NAME.js through the test driver and compares its output
+# with tests/NAME.out; the profiler smoke test also needs samples on disk,
+# the slice and string length tests run under a heap limit, the budget
+# and watchdog tests under a step and a time limit, scripts
+# that must end in an error expect a nonzero status, and the bulk test
+# runs once per CL_BULK level. Tests of the
+# driver's reports append the parts of the report that depend neither on
+# timing nor on exact object sizes.
+cd "$(dirname "$0")/.." || exit 1
+
+# Retainers of 100000 bytes or more: node name and path
+heapReport() {
+	awk 'NR > 2 && $1 >= 100000 { print $3, $4 }' "$1"
+}
+
+# Calls report rows without their timings, which only have to nest,
+# sorted since rows are ordered by exclusive time
+callsReport() {
+	sed -n 's/^ *{\(.*\),"inclusive_ms":\([0-9.]*\),"exclusive_ms":\([0-9.]*\)},*$/\1 \2 \3/p' "$1" |
+		awk '{ print $1, ($2 >= $3 ? "nested" : "NOT NESTED") }' | sort
+}
+
+# Allocation report rows in byte order, ties by site, without the sizes
+# themselves or the builtins' rows
+allocsReport() {
+	awk 'NR > 1 && $5 != "(runtime)"' "$1" | LC_ALL=C sort -k1,1nr -k5,5 |
+		awk '{ print $2, $3, $4, $5 }'
+}
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+for js in tests/*.js; do
+	name=$(basename "$js" .js)
+	expect=0
+	report=""
+	levels="detected"
+	case "$name" in
+		profile) args="-p $tmp/profile.folded" ;;
+		slices) args="-M 33554432" ;;
+		strlen) args="-M 33554432"; expect=1 ;;
+		heap) args="-R $tmp/report"; report=heapReport ;;
+		calls) args="-c $tmp/report"; report=callsReport ;;
+		allocs) args="-a $tmp/report"; report=allocsReport ;;
+		bulk) args=""; levels="scalar sse2 avx2" ;;
+		output) args="-O 16"; expect=1 ;;
+		budget) args="-S 701"; expect=1 ;;
+		watchdog) args="-T 100"; expect=1 ;;
+		*) args="" ;;
+	esac
+
+	for level in $levels; do
+		label=$name
+		if [ "$level" != detected ]; then
+			label="$name ($level)"
+		fi
+
+		CL_BULK=$level ./test $args "$js" > "$tmp/$name.txt" 2>&1
+		status=$?
+		if [ -n "$report" ] && [ -f "$tmp/report" ]; then
+			$report "$tmp/report" >> "$tmp/$name.txt"
+			rm -f "$tmp/report"
+		fi
+		if [ $status -eq $expect ] && cmp -s "$tmp/$name.txt" "tests/$name.out"; then
+			echo "ok   $label"
+		else
+			echo "FAIL $label (exit $status)"
+			diff "tests/$name.out" "$tmp/$name.txt" | head -20
+			failed=1
+		fi
+	done
+done
+
+if [ ! -s "$tmp/profile.folded" ]; then
+	echo "FAIL profile: no samples written"
+	failed=1
+fi
+
+exit $failed
@@ -0,0 +1,12 @@
+// Short slices of large strings are copied: the parents below are freed
+// as soon as each iteration ends, keeping the run under its memory limit
+var big = "0123456789abcdef";
+for (var i = 0; i < 16; i++) {
+	big = big + big;
+}
+var keep = [];
+for (var r = 0; r < 64; r++) {
+	var s = (r + big).slice(0, 1048576);
+	keep[r] = s.slice(100, 140);
+}
+print(big.length + " " + keep.length + " " + keep[63]);
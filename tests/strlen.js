@@ -0,0 +1,13 @@
+// Doubling a rope costs almost nothing, so the length cap, not the heap
+// limit, must stop it; the script ends with the engine's error rather
+// than a length overflow.
+var s = "0123456789abcdef";
+var n = 0;
+while (s.length < 536870912) {
+	s = s + s;
+	n++;
+}
+print(n + " " + s.length);
+print((s + "x".slice(1)).length === s.length);
+s = s + s;
+print("unreachable");
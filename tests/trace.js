@@ -0,0 +1,81 @@
+// Traced loops must agree with the interpreter: each loop runs well past
+// the hot-loop threshold, and the same step through a call (which is never
+// traced) gives the interpreter's answer.
+function check(name, traced, interpreted) {
+	print(name + " " + traced + (traced === interpreted ? "" : " != " + interpreted));
+}
+
+function mod(s) { return (s + 5.5) % 7; }
+function shl(t) { return (t + 1) << 31; }
+function shlWide(t) { return (t + 3) << 70; }
+function or(u) { return (u + 2147483647) | 0; }
+function and(u) { return (u + 4294967301) & 65535; }
+function xor(u) { return (u ^ 2863311530.5) + 1; }
+function shr(u) { return (u - 3000000000) >> 33; }
+function not(u) { return ~(u + 2147483648.75); }
+function elem(v, i) { return v[i]; }
+function truth(z) { if (z) { return 1; } return 0; }
+function falsy(z) { if (!z) { return 1; } return 0; }
+
+var n = 100;
+var i, a, b;
+
+a = 0; for (i = 0; i < n; i++) { a = (a + 5.5) % 7; }
+b = 0; for (i = 0; i < n; i++) { b = mod(b); }
+check("mod", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = (a + 1) << 31; }
+b = 0; for (i = 0; i < n; i++) { b = shl(b); }
+check("shl", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = (a + 3) << 70; }
+b = 0; for (i = 0; i < n; i++) { b = shlWide(b); }
+check("shl64", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = (a + 2147483647) | 0; }
+b = 0; for (i = 0; i < n; i++) { b = or(b); }
+check("or", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = (a + 4294967301) & 65535; }
+b = 0; for (i = 0; i < n; i++) { b = and(b); }
+check("and", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = (a ^ 2863311530.5) + 1; }
+b = 0; for (i = 0; i < n; i++) { b = xor(b); }
+check("xor", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = (a - 3000000000) >> 33; }
+b = 0; for (i = 0; i < n; i++) { b = shr(b); }
+check("shr", a, b);
+
+a = 0; for (i = 0; i < n; i++) { a = ~(a + 2147483648.75); }
+b = 0; for (i = 0; i < n; i++) { b = not(b); }
+check("not", a, b);
+
+var arr = [];
+for (i = 0; i < n; i++) { arr[i] = i * 1.5; }
+arr[60] = 0 / 0;
+a = 0; for (i = 0; i < arr.length; i++) { a += arr[i] === arr[i] ? arr[i] : 1000; }
+b = 0; for (i = 0; i < arr.length; i++) { b += elem(arr, i) === elem(arr, i) ? elem(arr, i) : 1000; }
+check("elem", a, b);
+
+var holes = [];
+for (i = 0; i < n; i++) { holes[i] = i; }
+delete holes[60];
+holes[70] = "s";
+a = 0; for (i = 0; i < n + 10; i++) { a += holes[i] > 0 ? 1 : 0; }
+b = 0; for (i = 0; i < n + 10; i++) { b += elem(holes, i) > 0 ? 1 : 0; }
+check("holes", a, b);
+
+var z;
+a = 0; for (i = 0; i < n; i++) { z = 0 / 0; if (z) { a++; } }
+b = 0; for (i = 0; i < n; i++) { z = 0 / 0; b += truth(z); }
+check("nan", a, b);
+
+a = 0; for (i = 0; i < n; i++) { z = 0 / 0; if (!z) { a++; } }
+b = 0; for (i = 0; i < n; i++) { z = 0 / 0; b += falsy(z); }
+check("!nan", a, b);
+
+a = 0; for (i = 0; i < n; i++) { z = i % 3 ? 0 / 0 : i; a += z ? 1 : 0; }
+b = 0; for (i = 0; i < n; i++) { z = i % 3 ? 0 / 0 : i; b += truth(z); }
+check("nan?", a, b);
@@ -0,0 +1,12 @@
+// Run with a 100 ms watchdog: another thread interrupts the endless loop,
+// in a trace or in the interpreter, and the script stops with the
+// output so far.
+function spin(k) {
+	var x = 0;
+	while (true) {
+		x = (x + k) % 7;
+	}
+}
+print("spinning");
+spin(3);
+print("never printed");
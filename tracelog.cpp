@@ -0,0 +1,99 @@
+#include "tracelog.h"
+#include "memory.h"
+
+#include <cstdlib>
+
+NAMESPACE_BEGIN
+
+static const char* const CATEGORIES[] = { "var", "assign", "setattr", "call" };
+
+static const char* categoryName(TraceLog::Category c)
+{
+	for (size_t i = 0; i < sizeof(CATEGORIES) / sizeof(CATEGORIES[0]); ++i)
+	{
+		if (c == 1u << i)
+		{
+			return CATEGORIES[i];
+		}
+	}
+	return "?";
+}
+
+TraceLog::TraceLog(): mask_(0), file_(NULL), count_(0)
+{
+	const char* spec = getenv("CL_TRACE");
+	if (spec == NULL)
+	{
+		return;
+	}
+
+	std::stringstream ss(spec);
+	std::string name;
+
+	while (std::getline(ss, name, ','))
+	{
+		for (size_t i = 0; i < sizeof(CATEGORIES) / sizeof(CATEGORIES[0]); ++i)
+		{
+			if (name == "all" || name == CATEGORIES[i])
+			{
+				mask_ |= 1u << i;
+			}
+		}
+	}
+
+	const char* path = getenv("CL_TRACE_FILE");
+	if (path && (file_ = fopen(path, "w")) != NULL)
+	{
+		setvbuf(file_, NULL, _IOFBF, FILE_BUFFER);
+	}
+	else
+	{
+		ring_.resize(RING_SIZE);
+	}
+}
+
+TraceLog::~TraceLog()
+{
+	if (file_)
+	{
+		fclose(file_);
+		return;
+	}
+
+	size_t n = std::min(count_, uint64_t(RING_SIZE));
+	for (size_t i = count_ - n; i < count_; ++i)
+	{
+		fputs(ring_[i % RING_SIZE].c_str(), stderr);
+	}
+}
+
+TraceLog& TraceLog::instance()
+{
+	static TraceLog inst;
+	return inst;
+}
+
+void TraceLog::event(Category c, const std::string& text)
+{
+	TraceLog& log = instance();
+	const char* name = categoryName(c);
+	std::lock_guard<std::mutex> l(log.lock_);
+
+	if (log.file_)
+	{
+		fputs(name, log.file_);
+		fputc(' ', log.file_);
+		fwrite(text.data(), 1, text.length(), log.file_);
+		fputc('\n', log.file_);
+	}
+	else
+	{
+		MemoryAccount::Suspend none;
+		std::string& slot = log.ring_[log.count_ % RING_SIZE];
+		slot.assign(name).append(" ").append(text).append("\n");
+	}
+
+	log.count_++;
+}
+
+NAMESPACE_END
@@ -0,0 +1,68 @@
+#ifndef _TRACELOG_H_
+#define _TRACELOG_H_
+
+#include "common.h"
+
+#include <cstdio>
+#include <mutex>
+
+NAMESPACE_BEGIN
+
+/*
+ * Interpreter event tracing. TRACE_EVENT compiles to nothing unless the
+ * build defines CL_TRACE (make TRACE=1). A traced build records the
+ * categories listed in $CL_TRACE ("var,assign,setattr,call" or "all")
+ * into the file named by $CL_TRACE_FILE through a large stdio buffer, or
+ * otherwise into a ring of the latest RING_SIZE events that is written
+ * to stderr at exit. Nothing is flushed per event. The log is shared by
+ * every thread, so each event is written under a lock.
+ */
+class TraceLog {
+public:
+	enum Category {
+		VAR = 1,
+		ASSIGN = 2,
+		SETATTR = 4,
+		CALL = 8
+	};
+
+	static const size_t RING_SIZE = 4096;
+	static const size_t FILE_BUFFER = 1 << 20;
+
+private:
+	unsigned mask_;
+	std::mutex lock_;
+	FILE* file_;
+	std::vector<std::string> ring_;
+	uint64_t count_;
+
+	TraceLog();
+	~TraceLog();
+
+	static TraceLog& instance();
+
+public:
+	static inline bool enabled(Category c)
+	{
+		return (instance().mask_ & c) != 0;
+	}
+
+	static void event(Category c, const std::string& text);
+};
+
+#ifdef CL_TRACE
+#define TRACE_EVENT(cat, msg) do { \
+		if (TraceLog::enabled(TraceLog::Category::cat)) \
+		{ \
+			std::ostringstream trace_ss_; \
+			trace_ss_ << msg; \
+			TraceLog::event(TraceLog::Category::cat, trace_ss_.str()); \
+		} \
+	} while (0)
+#else
+#define TRACE_EVENT(cat, msg) do {} while (0)
+#endif
+
+NAMESPACE_END
+
+#endif
@@ -0,0 +1,452 @@
+#include "typedarray.h"
+#include "bulk.h"
+#include "vm.h"
+
+#include <cstring>
+
+NAMESPACE_BEGIN
+
+static const Atom LENGTH = atom("length");
+static const Atom BYTE_LENGTH = atom("byteLength");
+static const Atom BYTE_OFFSET = atom("byteOffset");
+static const Atom BUFFER = atom("buffer");
+
+static ValuePtr number(double d)
+{
+	return std::isnan(d) ? NotaNumber::instance() : ValuePtr(new Number(d));
+}
+
+static uint32_t toLength(const ValuePtr& v, const char* who)
+{
+	double d = v->toNumber();
+	if (!(d >= 0) || d >= UINT32_MAX || d != std::trunc(d))
+	{
+		std::stringstream ss;
+		ss << who << ": invalid length " << v->toString();
+		throw ExecError(ss.str());
+	}
+	return uint32_t(d);
+}
+
+ValuePtr ArrayBufferValue::getAttr(const Key& key)
+{
+	if (key.atom_ == BYTE_LENGTH)
+	{
+		return ValuePtr(new Number(int64_t(data_.size())));
+	}
+	return ObjectLike::getAttr(key);
+}
+
+TypedArrayValue::TypedArrayValue(Kind kind, ValuePtr buffer, uint32_t offset, uint32_t length):
+	ObjectLike(Value::Type::TYPED_ARRAY), kind_(kind), buffer_(buffer),
+	offset_(offset), length_(length)
+{
+	data_ = static_cast<ArrayBufferValue*>(buffer.get())->data_.data() + offset;
+}
+
+size_t TypedArrayValue::elementSize(Kind kind)
+{
+	switch (kind)
+	{
+		case Kind::FLOAT64: return sizeof(double);
+		case Kind::INT32: return sizeof(int32_t);
+		default: return sizeof(uint8_t);
+	}
+}
+
+const char* TypedArrayValue::kindName(Kind kind)
+{
+	switch (kind)
+	{
+		case Kind::FLOAT64: return "Float64Array";
+		case Kind::INT32: return "Int32Array";
+		default: return "Uint8Array";
+	}
+}
+
+void TypedArrayValue::setIndex(uint32_t i, const ValuePtr& v)
+{
+	if (i >= length_)
+	{
+		return;
+	}
+
+	auto n = v->type_ == Value::Type::NUMBER ? dynamic_cast<Number*>(v.get()) : NULL;
+
+	switch (kind_)
+	{
+		case Kind::FLOAT64:
+			elements<double>()[i] = n ? n->num_ : v->toNumber();
+			break;
+		case Kind::INT32:
+			elements<int32_t>()[i] = n && n->isInt_ ? n->int_ : wrap32(v->toNumber());
+			break;
+		default:
+			elements<uint8_t>()[i] = uint8_t(n && n->isInt_ ? n->int_ : wrap32(v->toNumber()));
+	}
+}
+
+static ValuePtr& typedPrototype();
+
+void TypedArrayValue::setAttr(const Key& key, ValuePtr v)
+{
+	uint32_t index;
+
+	if (ArrayValue::toIndex(key.name(), index))
+	{
+		setIndex(index, v);
+	}
+	else if (key.atom_ != LENGTH && key.atom_ != BYTE_LENGTH
+		&& key.atom_ != BYTE_OFFSET && key.atom_ != BUFFER)
+	{
+		ObjectLike::setAttr(key, v);
+	}
+}
+
+ValuePtr TypedArrayValue::getAttr(const Key& key)
+{
+	uint32_t index;
+
+	if (key.atom_ == LENGTH)
+	{
+		return ValuePtr(new Number(int64_t(length_)));
+	}
+	if (key.atom_ == BYTE_LENGTH)
+	{
+		return ValuePtr(new Number(int64_t(length_ * elementSize(kind_))));
+	}
+	if (key.atom_ == BYTE_OFFSET)
+	{
+		return ValuePtr(new Number(int64_t(offset_)));
+	}
+	if (key.atom_ == BUFFER)
+	{
+		return buffer_;
+	}
+	if (ArrayValue::toIndex(key.name(), index))
+	{
+		return getIndex(index);
+	}
+
+	ValuePtr* r = find(key);
+	return r ? *r : typedPrototype()->getAttr(key);
+}
+
+std::vector<Key> TypedArrayValue::getKeys()
+{
+	std::vector<Key> ret;
+
+	for (uint32_t i = 0; i < length_; ++i)
+	{
+		ret.push_back(indexKey(i));
+	}
+
+	auto own = ObjectLike::getKeys();
+	ret.insert(ret.end(), own.begin(), own.end());
+
+	return ret;
+}
+
+std::string TypedArrayValue::toString()
+{
+	std::string ret;
+
+	for (uint32_t i = 0; i < length_; ++i)
+	{
+		if (i > 0)
+		{
+			ret += ",";
+		}
+		ret += getIndex(i)->toString();
+	}
+
+	return ret;
+}
+
+static TypedArrayValue* receiver(const ValuePtr& self, const char* method)
+{
+	if (self == nullptr || self->type_ != Value::Type::TYPED_ARRAY)
+	{
+		std::stringstream ss;
+		ss << method << " called on a value that is not a typed array";
+		throw ExecError(ss.str());
+	}
+	return static_cast<TypedArrayValue*>(self.get());
+}
+
+static TypedArrayValue* operand(TypedArrayValue* self, const ValuePtr& other, const char* method)
+{
+	auto arr = other->type_ == Value::Type::TYPED_ARRAY
+		? static_cast<TypedArrayValue*>(other.get()) : NULL;
+
+	if (arr == NULL || arr->kind_ != self->kind_ || arr->length_ < self->length_)
+	{
+		std::stringstream ss;
+		ss << method << " expects a number or a " << TypedArrayValue::kindName(self->kind_)
+			<< " of at least " << self->length_ << " elements";
+		throw ExecError(ss.str());
+	}
+	return arr;
+}
+
+static ValuePtr arg(const std::vector<ValuePtr>& args, size_t i)
+{
+	return i < args.size() ? args[i] : Undefined::instance();
+}
+
+static ValuePtr create(TypedArrayValue::Kind kind, uint32_t length)
+{
+	ValuePtr buffer(new ArrayBufferValue(size_t(length) * TypedArrayValue::elementSize(kind)));
+	return ValuePtr(new TypedArrayValue(kind, buffer, 0, length));
+}
+
+static ValuePtr arrayBufferCtor(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	return ValuePtr(new ArrayBufferValue(args.empty() ? 0 : toLength(args[0], "ArrayBuffer")));
+}
+
+template<TypedArrayValue::Kind K>
+static ValuePtr typedArrayCtor(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	const char* name = TypedArrayValue::kindName(K);
+	size_t size = TypedArrayValue::elementSize(K);
+	ValuePtr src = arg(args, 0);
+
+	if (auto buf = dynamic_cast<ArrayBufferValue*>(src.get()))
+	{
+		size_t bytes = buf->data_.size();
+		uint32_t offset = args.size() > 1 ? toLength(args[1], name) : 0;
+
+		if (offset % size != 0 || offset > bytes)
+		{
+			std::stringstream ss;
+			ss << name << ": invalid byte offset " << offset;
+			throw ExecError(ss.str());
+		}
+
+		uint32_t length;
+		if (args.size() > 2)
+		{
+			length = toLength(args[2], name);
+			if (offset + uint64_t(length) * size > bytes)
+			{
+				std::stringstream ss;
+				ss << name << ": length " << length << " is out of the buffer";
+				throw ExecError(ss.str());
+			}
+		}
+		else if ((bytes - offset) % size != 0)
+		{
+			std::stringstream ss;
+			ss << name << ": buffer length is not a multiple of " << size;
+			throw ExecError(ss.str());
+		}
+		else
+		{
+			length = (bytes - offset) / size;
+		}
+
+		return ValuePtr(new TypedArrayValue(K, src, offset, length));
+	}
+
+	uint32_t length = 0;
+
+	if (src->type_ == Value::Type::ARRAY)
+	{
+		length = static_cast<ArrayValue*>(src.get())->length();
+	}
+	else if (src->type_ == Value::Type::TYPED_ARRAY)
+	{
+		length = static_cast<TypedArrayValue*>(src.get())->length_;
+	}
+	else if (src->type_ != Value::Type::UNDEFINED)
+	{
+		length = toLength(src, name);
+	}
+
+	ValuePtr hold = create(K, length);
+	auto ret = static_cast<TypedArrayValue*>(hold.get());
+
+	if (src->type_ == Value::Type::ARRAY)
+	{
+		auto arr = static_cast<ArrayValue*>(src.get());
+		for (uint32_t i = 0; i < length; ++i)
+		{
+			ret->setIndex(i, arr->getIndex(i));
+		}
+	}
+	else if (src->type_ == Value::Type::TYPED_ARRAY)
+	{
+		auto arr = static_cast<TypedArrayValue*>(src.get());
+		for (uint32_t i = 0; i < length; ++i)
+		{
+			ret->setIndex(i, arr->getIndex(i));
+		}
+	}
+
+	return hold;
+}
+
+static ValuePtr fill(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto arr = receiver(self, "fill");
+	double d = arg(args, 0)->toNumber();
+
+	switch (arr->kind_)
+	{
+		case TypedArrayValue::Kind::FLOAT64:
+			Bulk::fill(arr->elements<double>(), d, arr->length_);
+			break;
+		case TypedArrayValue::Kind::INT32:
+			Bulk::fill(arr->elements<int32_t>(), wrap32(d), arr->length_);
+			break;
+		default:
+			Bulk::fill(arr->elements<uint8_t>(), uint8_t(wrap32(d)), arr->length_);
+	}
+
+	return self;
+}
+
+static ValuePtr set(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args)
+{
+	auto arr = receiver(self, "set");
+	ValuePtr src = arg(args, 0);
+	uint32_t offset = args.size() > 1 ? toLength(args[1], "set") : 0;
+	uint32_t length;
+
+	if (src->type_ == Value::Type::TYPED_ARRAY)
+	{
+		length = static_cast<TypedArrayValue*>(src.get())->length_;
+	}
+	else if (src->type_ == Value::Type::ARRAY)
+	{
+		length = static_cast<ArrayValue*>(src.get())->length();
+	}
+	else
+	{
+		throw ExecError("set expects an array or a typed array");
+	}
+
+	if (offset + uint64_t(length) > arr->length_)
+	{
+		throw ExecError("set: source is too large");
+	}
+
+	if (src->type_ == Value::Type::TYPED_ARRAY
+		&& static_cast<TypedArrayValue*>(src.get())->kind_ == arr->kind_)
+	{
+		size_t size = TypedArrayValue::elementSize(arr->kind_);
+		memmove(arr->data_ + offset * size,
+			static_cast<TypedArrayValue*>(src.get())->data_, length * size);
+	}
+	else if (src->type_ == Value::Type::TYPED_ARRAY)
+	{
+		auto from = static_cast<TypedArrayValue*>(src.get());
+		for (uint32_t i = 0; i < length; ++i)
+		{
+			arr->setIndex(offset + i, from->getIndex(i));
+		}
+	}
+	else
+	{
+		auto from = static_cast<ArrayValue*>(src.get());
+		for (uint32_t i = 0; i < length; ++i)
+		{
+			arr->setIndex(offset + i, from->getIndex(i));
+		}
+	}
+
+	return Undefined::instance();
+}
+
+#define REDUCE(name) \
+	static ValuePtr name(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args) \
+	{ \
+		auto arr = receiver(self, #name); \
+		switch (arr->kind_) \
+		{ \
+			case TypedArrayValue::Kind::FLOAT64: \
+				return number(Bulk::name(arr->elements<double>(), arr->length_)); \
+			case TypedArrayValue::Kind::INT32: \
+				return number(Bulk::name(arr->elements<int32_t>(), arr->length_)); \
+			default: \
+				return number(Bulk::name(arr->elements<uint8_t>(), arr->length_)); \
+		} \
+	}
+
+REDUCE(sum)
+REDUCE(min)
+REDUCE(max)
+
+#undef REDUCE
+
+/* this[i] = this[i] op other[i], where other is a same-kind array or a number */
+#define ELEMENTWISE(name) \
+	static ValuePtr name(VM* vm, const ValuePtr& self, const std::vector<ValuePtr>& args) \
+	{ \
+		auto arr = receiver(self, #name); \
+		ValuePtr other = arg(args, 0); \
+		TypedArrayValue* src; \
+		ValuePtr tmp; \
+		if (other->type_ == Value::Type::NUMBER) \
+		{ \
+			tmp = create(arr->kind_, arr->length_); \
+			fill(vm, tmp, args); \
+			src = static_cast<TypedArrayValue*>(tmp.get()); \
+		} \
+		else \
+		{ \
+			src = operand(arr, other, #name); \
+		} \
+		switch (arr->kind_) \
+		{ \
+			case TypedArrayValue::Kind::FLOAT64: \
+				Bulk::name(arr->elements<double>(), src->elements<double>(), arr->length_); \
+				break; \
+			case TypedArrayValue::Kind::INT32: \
+				Bulk::name(arr->elements<int32_t>(), src->elements<int32_t>(), arr->length_); \
+				break; \
+			default: \
+				Bulk::name(arr->elements<uint8_t>(), src->elements<uint8_t>(), arr->length_); \
+		} \
+		return self; \
+	}
+
+ELEMENTWISE(add)
+ELEMENTWISE(mul)
+
+#undef ELEMENTWISE
+
+static ValuePtr& typedPrototype()
+{
+	ValuePtr& proto = Isolate::current()->typedProto_;
+
+	if (proto == nullptr)
+	{
+		auto obj = new ObjectValue();
+		proto.reset(obj);
+		obj->attr_[atom("fill")] = ValuePtr(new NativeFunction("fill", fill));
+		obj->attr_[atom("set")] = ValuePtr(new NativeFunction("set", set));
+		obj->attr_[atom("sum")] = ValuePtr(new NativeFunction("sum", sum));
+		obj->attr_[atom("min")] = ValuePtr(new NativeFunction("min", min));
+		obj->attr_[atom("max")] = ValuePtr(new NativeFunction("max", max));
+		obj->attr_[atom("add")] = ValuePtr(new NativeFunction("add", add));
+		obj->attr_[atom("mul")] = ValuePtr(new NativeFunction("mul", mul));
+	}
+
+	return proto;
+}
+
+void loadTypedArrays(Scope* global)
+{
+	global->setVar(atom("ArrayBuffer"),
+		ValuePtr(new NativeFunction("ArrayBuffer", NULL, arrayBufferCtor)));
+	global->setVar(atom("Float64Array"), ValuePtr(new NativeFunction("Float64Array",
+		NULL, typedArrayCtor<TypedArrayValue::Kind::FLOAT64>)));
+	global->setVar(atom("Int32Array"), ValuePtr(new NativeFunction("Int32Array",
+		NULL, typedArrayCtor<TypedArrayValue::Kind::INT32>)));
+	global->setVar(atom("Uint8Array"), ValuePtr(new NativeFunction("Uint8Array",
+		NULL, typedArrayCtor<TypedArrayValue::Kind::UINT8>)));
+}
+
+NAMESPACE_END
@@ -0,0 +1,103 @@
+#ifndef _TYPEDARRAY_H_
+#define _TYPEDARRAY_H_
+
+#include "value.h"
+
+NAMESPACE_BEGIN
+
+class ArrayBufferValue: public ObjectLike {
+public:
+	std::vector<uint8_t> data_;
+
+public:
+	ArrayBufferValue(size_t bytes): ObjectLike(Value::Type::OBJECT), data_(bytes, 0)
+	{}
+
+	ValuePtr getAttr(const Key& key);
+
+	std::string toString()
+	{
+		return "[object ArrayBuffer]";
+	}
+	bool toBool()
+	{
+		return true;
+	}
+	std::string typeof()
+	{
+		return "object";
+	}
+};
+
+/*
+ * A fixed-length view of numbers stored unboxed in an ArrayBuffer.
+ * Stores convert like JS: Int32 and Uint8 wrap, Float64 keeps doubles.
+ */
+class TypedArrayValue: public ObjectLike {
+public:
+	enum Kind {
+		FLOAT64,
+		INT32,
+		UINT8
+	};
+
+	Kind kind_;
+	ValuePtr buffer_;
+	uint8_t* data_;
+	uint32_t offset_;
+	uint32_t length_;
+
+public:
+	TypedArrayValue(Kind kind, ValuePtr buffer, uint32_t offset, uint32_t length);
+
+	static size_t elementSize(Kind kind);
+	static const char* kindName(Kind kind);
+
+	template<typename T>
+	inline T* elements()
+	{
+		return reinterpret_cast<T*>(data_);
+	}
+
+	inline ValuePtr getIndex(uint32_t i)
+	{
+		if (i >= length_)
+		{
+			return Undefined::instance();
+		}
+
+		switch (kind_)
+		{
+			case Kind::FLOAT64:
+			{
+				double d = elements<double>()[i];
+				return std::isnan(d) ? NotaNumber::instance() : ValuePtr(new Number(d));
+			}
+			case Kind::INT32:
+				return ValuePtr(new Number(elements<int32_t>()[i]));
+			default:
+				return ValuePtr(new Number(int32_t(elements<uint8_t>()[i])));
+		}
+	}
+	void setIndex(uint32_t i, const ValuePtr& v);
+
+	void setAttr(const Key& key, ValuePtr v);
+	ValuePtr getAttr(const Key& key);
+	std::vector<Key> getKeys();
+
+	std::string toString();
+	bool toBool()
+	{
+		return true;
+	}
+	std::string typeof()
+	{
+		return "object";
+	}
+};
+
+void loadTypedArrays(Scope* global);
+
+NAMESPACE_END
+
+#endif
@@ -1,42 +1,616 @@
 #include "value.h"
+#include "vm.h"
 
 NAMESPACE_BEGIN
 
-void Value::setAttr(const std::string& key, ValuePtr v)
+void* Value::operator new(size_t bytes)
 {
-	std::cout << "set " << key << " = " << v->toString() << std::endl;
-	attr_[key] = v;
+	if (AllocProfile* allocs = AllocProfile::current())
+	{
+		allocs->expectValue();
+	}
+	return ::operator new(bytes);
+}
+
+void Value::operator delete(void* p)
+{
+	::operator delete(p);
+}
+
+void Value::setAttr(const Key& key, ValuePtr v)
+{
+}
+
+ValuePtr Value::getAttr(const Key& key)
+{
+	auto& proto = prototype(type_);
+	return proto ? proto->getAttr(key) : Undefined::instance();
+}
+
+void Value::delAttr(const Key& key)
+{
+}
+
+std::vector<Key> Value::getKeys()
+{
+	return std::vector<Key>();
+}
+
+ValuePtr& Value::prototype(Type type)
+{
+	return Isolate::current()->protos_[type];
+}
+
+/*
+ * A name interned after it was first used as a computed key may still
+ * sit in named_, so atom lookups fall back to it while it is non-empty.
+ */
+ValuePtr* ObjectLike::find(const Key& key)
+{
+	if (key.atom_ != NO_ATOM)
+	{
+		auto r = attr_.find(key.atom_);
+		if (r != attr_.end())
+		{
+			return &r->second;
+		}
+		if (named_.empty())
+		{
+			return NULL;
+		}
+	}
+
+	auto r = key.atom_ == NO_ATOM ? named_.find(key) : named_.find(Key(key.name()));
+	return r != named_.end() ? &r->second : NULL;
+}
+
+void ObjectLike::setAttr(const Key& key, ValuePtr v)
+{
+	TRACE_EVENT(SETATTR, key.name() << " = " << v->toString());
+
+	if (key.atom_ == NO_ATOM)
+	{
+		named_[key] = v;
+		return;
+	}
+	if (!named_.empty())
+	{
+		named_.erase(Key(atomName(key.atom_)));
+	}
+	attr_[key.atom_] = v;
 }
 
-ValuePtr Value::getAttr(const std::string& key)
+ValuePtr ObjectLike::getAttr(const Key& key)
+{
+	ValuePtr* r = find(key);
+	return r ? *r : Undefined::instance();
+}
+
+void ObjectLike::delAttr(const Key& key)
+{
+	if (key.atom_ != NO_ATOM)
+	{
+		attr_.erase(key.atom_);
+	}
+	if (!named_.empty())
+	{
+		named_.erase(key.atom_ == NO_ATOM ? key : Key(key.name()));
+	}
+}
+
+static const Atom LENGTH = atom("length");
+
+bool ArrayValue::toIndex(const std::string& key, uint32_t& index)
 {
-	if (attr_.find(key) != attr_.end())
+	size_t n = key.length();
+
+	if (n == 0 || n > 10 || (key[0] == '0' && n > 1))
+	{
+		return false;
+	}
+
+	uint64_t v = 0;
+	for (auto c : key)
 	{
-		return attr_[key];
+		if (c < '0' || c > '9')
+		{
+			return false;
+		}
+		v = v * 10 + (c - '0');
 	}
-	return Undefined::instance();
+
+	if (v >= UINT32_MAX)
+	{
+		return false;
+	}
+	index = uint32_t(v);
+	return true;
 }
 
-void Value::delAttr(const std::string& key)
+bool ArrayValue::toIndex(const ValuePtr& key, uint32_t& index)
 {
-	if (attr_.find(key) != attr_.end())
+	if (key->type_ == Value::Type::NUMBER)
 	{
-		attr_.erase(key);
+		auto n = dynamic_cast<Number*>(key.get());
+		if (n != NULL && n->isInt_ && n->int_ >= 0)
+		{
+			index = uint32_t(n->int_);
+			return true;
+		}
+		return false;
 	}
+
+	if (key->type_ == Value::Type::STRING)
+	{
+		return toIndex(static_cast<StringValue*>(key.get())->str(), index);
+	}
+
+	return false;
 }
 
-std::vector<std::string> Value::getKeys()
+void ArrayValue::grow(uint32_t size)
 {
-	std::vector<std::string> ret;
+	uint32_t old = elems_.size();
+	elems_.resize(size);
 
-	for (auto i : attr_)
+	if (sparse_ == 0)
+	{
+		return;
+	}
+
+	for (auto i = named_.begin(); i != named_.end();)
+	{
+		uint32_t index;
+		if (toIndex(i->first.name_, index) && index >= old && index < size)
+		{
+			elems_[index] = i->second;
+			i = named_.erase(i);
+			--sparse_;
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void ArrayValue::setSlow(uint32_t i, ValuePtr v)
+{
+	uint64_t size = elems_.size();
+
+	if (i < size)
+	{
+		elems_[i] = v;
+	}
+	else if (i < size + MAX_GAP || i < 2 * size)
+	{
+		grow(i + 1);
+		elems_[i] = v;
+	}
+	else
+	{
+		auto r = named_.emplace(Key(std::to_string(i)), v);
+		if (r.second)
+		{
+			++sparse_;
+		}
+		else
+		{
+			r.first->second = v;
+		}
+	}
+
+	if (i >= length_)
+	{
+		length_ = i + 1;
+	}
+}
+
+ValuePtr ArrayValue::getSparse(uint32_t i)
+{
+	auto r = named_.find(Key(std::to_string(i)));
+	return r != named_.end() ? r->second : Undefined::instance();
+}
+
+void ArrayValue::delIndex(uint32_t i)
+{
+	if (i < elems_.size())
+	{
+		elems_[i].reset();
+	}
+	else if (sparse_ && named_.erase(Key(std::to_string(i))))
+	{
+		--sparse_;
+	}
+}
+
+void ArrayValue::push(ValuePtr v)
+{
+	setIndex(length_, v);
+}
+
+void ArrayValue::setLength(uint32_t n)
+{
+	if (n < elems_.size())
+	{
+		elems_.resize(n);
+	}
+
+	if (sparse_ && n < length_)
+	{
+		for (auto i = named_.begin(); i != named_.end();)
+		{
+			uint32_t index;
+			if (toIndex(i->first.name_, index) && index >= n)
+			{
+				i = named_.erase(i);
+				--sparse_;
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	length_ = n;
+}
+
+void ArrayValue::setAttr(const Key& key, ValuePtr v)
+{
+	uint32_t index;
+
+	if (key.atom_ == LENGTH)
+	{
+		auto n = dynamic_cast<Number*>(v.get());
+		if (n != NULL && n->num_ >= 0 && n->num_ < UINT32_MAX)
+		{
+			setLength(uint32_t(n->num_));
+		}
+	}
+	else if (toIndex(key.name(), index))
+	{
+		setIndex(index, v);
+	}
+	else
+	{
+		ObjectLike::setAttr(key, v);
+	}
+}
+
+ValuePtr ArrayValue::getAttr(const Key& key)
+{
+	uint32_t index;
+
+	if (key.atom_ == LENGTH)
+	{
+		return ValuePtr(new Number(int64_t(length_)));
+	}
+	if (toIndex(key.name(), index))
+	{
+		return getIndex(index);
+	}
+	return ObjectLike::getAttr(key);
+}
+
+void ArrayValue::delAttr(const Key& key)
+{
+	uint32_t index;
+
+	if (toIndex(key.name(), index))
+	{
+		delIndex(index);
+	}
+	else if (key.atom_ != LENGTH)
+	{
+		ObjectLike::delAttr(key);
+	}
+}
+
+std::vector<Key> ArrayValue::getKeys()
+{
+	std::vector<uint32_t> indices;
+	std::vector<Key> ret;
+
+	for (uint32_t i = 0; i < elems_.size(); ++i)
+	{
+		if (elems_[i])
+		{
+			indices.push_back(i);
+		}
+	}
+
+	for (auto& key : ObjectLike::getKeys())
+	{
+		uint32_t index;
+		if (toIndex(key.name(), index))
+		{
+			indices.push_back(index);
+		}
+		else
+		{
+			ret.push_back(key);
+		}
+	}
+
+	std::sort(indices.begin(), indices.end());
+
+	std::vector<Key> keys;
+	for (auto i : indices)
+	{
+		keys.push_back(indexKey(i));
+	}
+	keys.insert(keys.end(), ret.begin(), ret.end());
+
+	return keys;
+}
+
+std::string ArrayValue::toString()
+{
+	std::string ret;
+
+	for (uint32_t i = 0; i < length_; ++i)
+	{
+		if (i > 0)
+		{
+			ret += ",";
+		}
+
+		ValuePtr v = getIndex(i);
+		if (v->type_ != Value::Type::UNDEFINED
+			&& v->type_ != Value::Type::NULLVAL)
+		{
+			ret += v->toString();
+		}
+	}
+
+	return ret;
+}
+
+StringValue::StringValue(const ValuePtr& left, const ValuePtr& right):
+	Value(Value::Type::STRING), left_(left), right_(right), offset_(0), atom_(NO_ATOM)
+{
+	auto l = static_cast<StringValue*>(left.get());
+	auto r = static_cast<StringValue*>(right.get());
+	length_ = l->length_ + r->length_;
+	depth_ = std::max(l->depth_, r->depth_) + 1;
+}
+
+StringValue::StringValue(const ValuePtr& parent, size_t offset, size_t length):
+	Value(Value::Type::STRING), left_(parent), offset_(offset), length_(length),
+	depth_(0), atom_(NO_ATOM)
+{}
+
+StringValue::~StringValue()
+{
+	release();
+}
+
+ValuePtr StringValue::concat(const ValuePtr& left, const ValuePtr& right)
+{
+	auto l = static_cast<StringValue*>(left.get());
+	auto r = static_cast<StringValue*>(right.get());
+
+	if (l->length_ == 0)
+	{
+		return right;
+	}
+	if (r->length_ == 0)
+	{
+		return left;
+	}
+	if (r->length_ > MAX_LENGTH || l->length_ > MAX_LENGTH - r->length_)
+	{
+		throw ExecError("Invalid string length");
+	}
+	if (l->length_ + r->length_ < MIN_CONS)
+	{
+		return ValuePtr(new StringValue(l->str() + r->str()));
+	}
+
+	if (l->depth_ >= MAX_DEPTH)
+	{
+		l->flatten();
+	}
+	if (r->depth_ >= MAX_DEPTH)
+	{
+		r->flatten();
+	}
+	return ValuePtr(new StringValue(left, right));
+}
+
+ValuePtr StringValue::slice(const ValuePtr& s, size_t begin, size_t end)
+{
+	auto str = static_cast<StringValue*>(s.get());
+	size_t n = end - begin;
+
+	if (n == str->length_)
+	{
+		return s;
+	}
+
+	const char* data = str->data();
+	if (n == 1)
+	{
+		return character(data[begin]);
+	}
+
+	// Always point at the flat parent so slices never chain
+	const ValuePtr& parent = str->left_ ? str->left_ : s;
+	size_t offset = str->left_ ? str->offset_ + begin : begin;
+
+	if (n < MIN_SLICE || n < static_cast<StringValue*>(parent.get())->length_ / SLICE_RATIO)
+	{
+		return ValuePtr(new StringValue(std::string(data + begin, n)));
+	}
+	return ValuePtr(new StringValue(parent, offset, n));
+}
+
+ValuePtr StringValue::character(char c)
+{
+	unsigned char u = c;
+
+	if (u >= 128)
+	{
+		return ValuePtr(new StringValue(std::string(1, c)));
+	}
+	return Isolate::current()->ascii_[u];
+}
+
+/*
+ * The atom is kept once found. A name that was not interned keeps its
+ * key, hash included, until the table grows and the name might have
+ * been added.
+ */
+const Key& StringValue::toKey(Key& tmp)
+{
+	if (atom_ == NO_ATOM)
+	{
+		AtomTable& table = AtomTable::instance();
+		size_t size = table.size();
+		if (missed_ && missed_->size_ == size)
+		{
+			return missed_->key_;
+		}
+
+		atom_ = table.find(str());
+		if (atom_ == NO_ATOM)
+		{
+			if (missed_)
+			{
+				missed_->size_ = size;
+			}
+			else
+			{
+				missed_.reset(new Missed(str(), size));
+			}
+			return missed_->key_;
+		}
+		missed_.reset();
+	}
+	return tmp = Key(atom_);
+}
+
+ValuePtr StringValue::getAttr(const Key& key)
+{
+	if (key.atom_ == LENGTH)
+	{
+		return ValuePtr(new Number(int64_t(length_)));
+	}
+	return Value::getAttr(key);
+}
+
+void StringValue::flatten()
+{
+	if (!right_)
+	{
+		auto parent = static_cast<StringValue*>(left_.get());
+		str_.assign(parent->str_, offset_, length_);
+		left_.reset();
+		offset_ = 0;
+		return;
+	}
+
+	std::string flat;
+	flat.reserve(length_);
+
+	std::vector<StringValue*> stack;
+	stack.push_back(this);
+
+	while (!stack.empty())
+	{
+		StringValue* cur = stack.back();
+		stack.pop_back();
+
+		if (cur->right_)
+		{
+			stack.push_back(static_cast<StringValue*>(cur->right_.get()));
+			stack.push_back(static_cast<StringValue*>(cur->left_.get()));
+		}
+		else
+		{
+			flat.append(cur->data(), cur->length_);
+		}
+	}
+
+	str_.swap(flat);
+	depth_ = 0;
+	release();
+}
+
+void StringValue::release()
+{
+	if (!right_)
+	{
+		return;
+	}
+
+	// Unlink uniquely owned cons nodes before they die so that dropping
+	// a long chain does not recurse through the destructors.
+	std::vector<ValuePtr> pending;
+	pending.push_back(std::move(left_));
+	pending.push_back(std::move(right_));
+
+	while (!pending.empty())
+	{
+		ValuePtr v = std::move(pending.back());
+		pending.pop_back();
+
+		auto s = static_cast<StringValue*>(v.get());
+		if (v.use_count() == 1 && s->right_)
+		{
+			pending.push_back(std::move(s->left_));
+			pending.push_back(std::move(s->right_));
+		}
+	}
+}
+
+std::vector<Key> ObjectLike::getKeys()
+{
+	std::vector<Key> ret;
+
+	for (auto& i : attr_)
+	{
+		ret.push_back(Key(i.first));
+	}
+	for (auto& i : named_)
 	{
 		ret.push_back(i.first);
 	}
 
-	std::sort(ret.begin(), ret.end());
+	std::sort(ret.begin(), ret.end(), [](const Key& a, const Key& b) {
+		return a.name() < b.name();
+	});
 
 	return ret;
 }
 
-NAMESPACE_END
\ No newline at end of file
+thread_local Isolate* Isolate::current_ = NULL;
+
+Isolate::Isolate():
+	undefined_(new Undefined()),
+	null_(new NullValue()),
+	nan_(new NotaNumber()),
+	normal_(new Signal(Signal::Type::NORMAL)),
+	break_(new Signal(Signal::Type::BREAK)),
+	continue_(new Signal(Signal::Type::CONTINUE)),
+	return_(new Signal(Signal::Type::RETURN))
+{
+	protos_[Value::Type::BOOL].reset(new ObjectValue());
+	protos_[Value::Type::NUMBER].reset(new ObjectValue());
+	protos_[Value::Type::STRING].reset(new ObjectValue());
+
+	for (int c = 0; c < 128; ++c)
+	{
+		ascii_[c].reset(new StringValue(std::string(1, char(c))));
+	}
+}
+
+Isolate* Isolate::shared()
+{
+	MemoryAccount::Suspend none;
+	static Isolate inst;
+	return &inst;
+}
+
+NAMESPACE_END
@@ -3,11 +3,15 @@
 
 #include "common.h"
 #include "ast.h"
+#include "numconv.h"
+#include "tracelog.h"
+#include "allocprofile.h"
 
 NAMESPACE_BEGIN
 
 class Undefined;
 class Value;
+class VM;
 
 typedef std::shared_ptr<Value> ValuePtr;
 
@@ -21,36 +25,127 @@ public:
 		STRING,
 		OBJECT,
 		FUNCTION,
+		ARRAY,
+		TYPED_ARRAY,
 		SIGNAL
 	};
 
 	Type type_;
-	std::unordered_map<std::string, ValuePtr> attr_;
 
 	Value(Type type): type_(type)
-	{}
+	{
+		if (AllocProfile* allocs = AllocProfile::current())
+		{
+			allocs->constructed(this, type);
+		}
+	}
 	virtual ~Value()
 	{}
 
-	void setAttr(const std::string& key, ValuePtr v);
-	ValuePtr getAttr(const std::string& key);
-	void delAttr(const std::string& key);
-	std::vector<std::string> getKeys();
+	static void* operator new(size_t bytes);
+	static void operator delete(void* p);
+
+	/* Primitives own no properties; reads go to the wrapper prototype */
+	virtual void setAttr(const Key& key, ValuePtr v);
+	virtual ValuePtr getAttr(const Key& key);
+	virtual void delAttr(const Key& key);
+	virtual std::vector<Key> getKeys();
+
+	static ValuePtr& prototype(Type type);
 
 	virtual std::string toString() = 0;
 	virtual bool toBool() = 0;
 	virtual std::string typeof() = 0;
+	virtual double toNumber()
+	{
+		return stringToNumber(toString());
+	}
+	/* The key this value names as obj[value]: built in tmp, or one the value keeps */
+	virtual const Key& toKey(Key& tmp)
+	{
+		return tmp = keyOf(toString());
+	}
+};
+
+/* Base of every value that carries its own property map */
+class ObjectLike: public Value {
+public:
+	std::unordered_map<Atom, ValuePtr> attr_;
+	/* Properties under computed names that were never interned */
+	std::unordered_map<Key, ValuePtr, Key::Hash> named_;
+
+	ObjectLike(Type type): Value(type)
+	{}
+
+	/* The slot holding key, or NULL */
+	ValuePtr* find(const Key& key);
+
+	void setAttr(const Key& key, ValuePtr v);
+	ValuePtr getAttr(const Key& key);
+	void delAttr(const Key& key);
+	std::vector<Key> getKeys();
+};
+
+/*
+ * The shared values of one VM: undefined, null, NaN, the control signals,
+ * the primitive prototypes and the one-character strings. Each VM owns an
+ * isolate and installs it on its thread while it runs, so VMs on separate
+ * threads share no mutable state and no reference counts. Code outside
+ * any VM, such as the parser, sees a process-wide isolate that is never
+ * written after construction.
+ */
+class Isolate {
+private:
+	static thread_local Isolate* current_;
+	static Isolate* shared();
+
+public:
+	ValuePtr undefined_;
+	ValuePtr null_;
+	ValuePtr nan_;
+	ValuePtr normal_;
+	ValuePtr break_;
+	ValuePtr continue_;
+	ValuePtr return_;
+	ValuePtr protos_[Value::Type::SIGNAL + 1];
+	ValuePtr typedProto_;
+	ValuePtr ascii_[128];
+
+	Isolate();
+
+	static inline Isolate* current()
+	{
+		Isolate* i = current_;
+		return i ? i : shared();
+	}
+
+	/* Makes an isolate current on this thread for its lifetime */
+	class Enter {
+	private:
+		Isolate* prev_;
+
+	public:
+		Enter(Isolate* isolate): prev_(current_)
+		{
+			current_ = isolate;
+		}
+		~Enter()
+		{
+			current_ = prev_;
+		}
+	};
 };
 
 class Undefined: public Value {
 private:
+	friend class Isolate;
+
 	Undefined(): Value(Value::Type::UNDEFINED)
 	{}
 public:
-	static ValuePtr instance()
+	static inline const ValuePtr& instance()
 	{
-		static ValuePtr inst(new Undefined());
-		return inst;
+		return Isolate::current()->undefined_;
 	}
 	std::string toString()
 	{
@@ -64,6 +159,10 @@ public:
 	{
 		return "undefined";
 	}
+	double toNumber()
+	{
+		return NAN;
+	}
 };
 
 class Boolean: public Value {
@@ -85,17 +184,22 @@ public:
 	{
 		return b_ ? "true" : "false";
 	}
+	double toNumber()
+	{
+		return b_ ? 1.0 : 0.0;
+	}
 };
 
 class NotaNumber: public Value {
 private:
+	friend class Isolate;
+
 	NotaNumber(): Value(Value::Type::NUMBER)
 	{}
 public:
-	static ValuePtr instance()
+	static inline const ValuePtr& instance()
 	{
-		static ValuePtr inst(new NotaNumber());
-		return inst;
+		return Isolate::current()->nan_;
 	}
 	std::string toString()
 	{
@@ -109,55 +213,174 @@ public:
 	{
 		return "number";
 	}
+	double toNumber()
+	{
+		return NAN;
+	}
 };
 
 class Number: public Value {
 public:
 	double num_;
+	int32_t int_;
+	bool isInt_;
 
 public:
 	Number(double n): Value(Value::Type::NUMBER), num_(n)
+	{
+		isInt_ = toInt32(n, int_);
+	}
+	Number(int64_t n): Value(Value::Type::NUMBER), num_(double(n)),
+		int_(int32_t(n)), isInt_(n >= INT32_MIN && n <= INT32_MAX)
 	{}
-	Number(int64_t n): Value(Value::Type::NUMBER), num_(double(n))
+	Number(int32_t n): Value(Value::Type::NUMBER), num_(double(n)),
+		int_(n), isInt_(true)
 	{}
+
+	static inline bool toInt32(double d, int32_t& out)
+	{
+		if (d >= INT32_MIN && d <= INT32_MAX)
+		{
+			int32_t i = int32_t(d);
+			if (double(i) == d && (i != 0 || !std::signbit(d)))
+			{
+				out = i;
+				return true;
+			}
+		}
+		out = 0;
+		return false;
+	}
+
 	std::string toString()
 	{
-		return std::to_string(num_);
+		return formatNumber(num_);
 	}
 	bool toBool()
 	{
-		return num_ != 0.0;
+		return num_ != 0.0 && !std::isnan(num_);
 	}
 	std::string typeof()
 	{
 		return "number";
 	}
+	double toNumber()
+	{
+		return num_;
+	}
+	const Key& toKey(Key& tmp)
+	{
+		return tmp = isInt_ && int_ >= 0 ? indexKey(uint32_t(int_)) : keyOf(toString());
+	}
 };
 
+/*
+ * A string is flat, a cons of two strings, or a slice of a flat string.
+ * Concatenation builds cons nodes in O(1); the contents are flattened on
+ * first read and the halves released. Both flattening and teardown are
+ * iterative, and a cons deeper than MAX_DEPTH is flattened eagerly.
+ * A cons costs almost nothing to build, so concatenation itself refuses
+ * results longer than MAX_LENGTH rather than waiting for the heap limit.
+ * Slices of at least MIN_SLICE bytes and 1/SLICE_RATIO of the parent
+ * share the parent's buffer and read through data(); shorter ones are
+ * copied so they cannot pin a large parent. str() copies the range out
+ * and drops the parent.
+ * Short contents live in str_'s inline buffer, and the atom is interned
+ * once on first use as a property key.
+ */
 class StringValue: public Value {
+	friend class HeapSnapshot;
+
 public:
+	static const size_t MIN_CONS = 16;
+	static const size_t MIN_SLICE = 16;
+	static const size_t SLICE_RATIO = 8;
+	static const int MAX_DEPTH = 1 << 16;
+	static const size_t MAX_LENGTH = (1 << 30) - 25;
+
+private:
+	// cons: left_ and right_; slice: left_ is the parent, right_ is null
 	std::string str_;
+	ValuePtr left_;
+	ValuePtr right_;
+	size_t offset_;
+	size_t length_;
+	int depth_;
+	Atom atom_;
+
+	/* A key that names no atom, valid while the atom table is the size it was looked up at */
+	struct Missed {
+		Key key_;
+		size_t size_;
+
+		Missed(const std::string& name, size_t size): key_(name), size_(size)
+		{}
+	};
+	std::unique_ptr<Missed> missed_;
+
+	StringValue(const ValuePtr& parent, size_t offset, size_t length);
+
+	void flatten();
+	void release();
 
 public:
-	StringValue(const std::string& str): Value(Value::Type::STRING), str_(str)
+	StringValue(const std::string& str): Value(Value::Type::STRING), str_(str),
+		offset_(0), length_(str.length()), depth_(0), atom_(NO_ATOM)
 	{}
-	std::string toString()
+	StringValue(const ValuePtr& left, const ValuePtr& right);
+	~StringValue();
+
+	ValuePtr getAttr(const Key& key);
+
+	static ValuePtr concat(const ValuePtr& left, const ValuePtr& right);
+	/* The bytes [begin, end) of s; requires begin <= end <= length */
+	static ValuePtr slice(const ValuePtr& s, size_t begin, size_t end);
+	/* A one-byte string, shared for ASCII */
+	static ValuePtr character(char c);
+
+	inline const std::string& str()
 	{
+		if (left_)
+		{
+			flatten();
+		}
 		return str_;
 	}
+	inline const char* data()
+	{
+		if (right_)
+		{
+			flatten();
+		}
+		return left_ ? static_cast<StringValue*>(left_.get())->str_.data() + offset_ : str_.data();
+	}
+	inline size_t length() const
+	{
+		return length_;
+	}
+
+	std::string toString()
+	{
+		return str();
+	}
 	bool toBool()
 	{
-		return str_ != "";
+		return length_ != 0;
 	}
 	std::string typeof()
 	{
 		return "string";
 	}
+	double toNumber()
+	{
+		return stringToNumber(str());
+	}
+	const Key& toKey(Key& tmp);
 };
 
-class ObjectValue: public Value {
+class ObjectValue: public ObjectLike {
 public:
-	ObjectValue(): Value(Value::Type::OBJECT)
+	ObjectValue(): ObjectLike(Value::Type::OBJECT)
 	{}
 	std::string toString()
 	{
@@ -173,15 +396,91 @@ public:
 	}
 };
 
+/*
+ * Elements [0, elems_.size()) live in a contiguous vector, with NULL
+ * marking holes. An index far beyond the dense part is stored as a
+ * named property under its decimal form instead and moved back once the
+ * vector reaches it.
+ */
+class ArrayValue: public ObjectLike {
+	friend class HeapSnapshot;
+
+public:
+	static const uint32_t MAX_GAP = 1024;
+
+private:
+	std::vector<ValuePtr> elems_;
+	uint32_t length_;
+	uint32_t sparse_;
+
+	void grow(uint32_t size);
+	ValuePtr getSparse(uint32_t i);
+
+public:
+	ArrayValue(): ObjectLike(Value::Type::ARRAY), length_(0), sparse_(0)
+	{}
+
+	static bool toIndex(const std::string& key, uint32_t& index);
+	static bool toIndex(const ValuePtr& key, uint32_t& index);
+
+	inline ValuePtr getIndex(uint32_t i)
+	{
+		if (i < elems_.size() && elems_[i])
+		{
+			return elems_[i];
+		}
+		return sparse_ ? getSparse(i) : Undefined::instance();
+	}
+	inline void setIndex(uint32_t i, ValuePtr v)
+	{
+		if (i < elems_.size())
+		{
+			elems_[i] = v;
+			return;
+		}
+		setSlow(i, v);
+	}
+	/* The element at i in the dense part, or NULL for a hole or an index past it */
+	inline Value* dense(uint32_t i) const
+	{
+		return i < elems_.size() ? elems_[i].get() : NULL;
+	}
+	void setSlow(uint32_t i, ValuePtr v);
+	void delIndex(uint32_t i);
+	void push(ValuePtr v);
+
+	inline uint32_t length() const
+	{
+		return length_;
+	}
+	void setLength(uint32_t n);
+
+	void setAttr(const Key& key, ValuePtr v);
+	ValuePtr getAttr(const Key& key);
+	void delAttr(const Key& key);
+	std::vector<Key> getKeys();
+
+	std::string toString();
+	bool toBool()
+	{
+		return true;
+	}
+	std::string typeof()
+	{
+		return "object";
+	}
+};
+
 class NullValue: public Value {
 private:
+	friend class Isolate;
+
 	NullValue(): Value(Value::Type::NULLVAL)
 	{}
 public:
-	static ValuePtr instance()
+	static inline const ValuePtr& instance()
 	{
-		static ValuePtr inst(new NullValue());
-		return inst;
+		return Isolate::current()->null_;
 	}
 	std::string toString()
 	{
@@ -195,14 +494,62 @@ public:
 	{
 		return "object";
 	}
+	double toNumber()
+	{
+		return 0.0;
+	}
+};
+
+/* The captured locals of one activation, shared with the closures it creates */
+class Env {
+public:
+	std::vector<ValuePtr> cells_;
+	std::shared_ptr<Env> parent_;
+
+public:
+	Env(size_t n, const std::shared_ptr<Env>& parent):
+		cells_(n, Undefined::instance()), parent_(parent)
+	{}
 };
 
-class FunctionValue: public Value {
+typedef std::shared_ptr<Env> EnvPtr;
+
+class FunctionValue: public ObjectLike {
 public:
 	Function* code_;
+	EnvPtr env_;
 
 public:
-	FunctionValue(Function* code): Value(Value::Type::FUNCTION), code_(code)
+	FunctionValue(Function* code, const EnvPtr& env):
+		ObjectLike(Value::Type::FUNCTION), code_(code), env_(env)
+	{}
+	std::string toString()
+	{
+		return "function";
+	}
+	bool toBool()
+	{
+		return true;
+	}
+	std::string typeof()
+	{
+		return "function";
+	}
+};
+
+/* A builtin written in C++; call_ serves plain calls and ctor_ serves new */
+typedef ValuePtr (*NativeCode)(VM* vm, const ValuePtr& self,
+	const std::vector<ValuePtr>& args);
+
+class NativeFunction: public ObjectLike {
+public:
+	std::string name_;
+	NativeCode call_;
+	NativeCode ctor_;
+
+public:
+	NativeFunction(const std::string& name, NativeCode call, NativeCode ctor = NULL):
+		ObjectLike(Value::Type::FUNCTION), name_(name), call_(call), ctor_(ctor)
 	{}
 	std::string toString()
 	{
@@ -231,6 +578,8 @@ public:
 	ValuePtr val_;
 
 private:
+	friend class Isolate;
+
 	Signal(Type sigtype): Value(Value::Type::SIGNAL), sigtype_(sigtype), val_(nullptr)
 	{}
 
@@ -248,29 +597,27 @@ public:
 
 	static ValuePtr sigBreak(Break* b)
 	{
-		static ValuePtr brk(new Signal(Type::BREAK));
-		dynamic_cast<Signal*>(brk.get())->pos_ = b->range_.begin_;
+		const ValuePtr& brk = Isolate::current()->break_;
+		static_cast<Signal*>(brk.get())->pos_ = b->range_.begin_;
 		return brk;
 	}
 
 	static ValuePtr sigContinue(Continue* c)
 	{
-		static ValuePtr con(new Signal(Type::CONTINUE));
-		dynamic_cast<Signal*>(con.get())->pos_ = c->range_.begin_;
+		const ValuePtr& con = Isolate::current()->continue_;
+		static_cast<Signal*>(con.get())->pos_ = c->range_.begin_;
 		return con;
 	}
 
-	static ValuePtr sigNormal()
+	static inline const ValuePtr& sigNormal()
 	{
-		static ValuePtr nor(new Signal(Type::NORMAL));
-		return nor;
+		return Isolate::current()->normal_;
 	}
 
 	static ValuePtr sigReturn(ValuePtr val)
 	{
-		Signal* inst = new Signal(Type::RETURN);
-		inst->val_ = val;
-		static ValuePtr ret(inst);
+		const ValuePtr& ret = Isolate::current()->return_;
+		static_cast<Signal*>(ret.get())->val_ = val;
 		return ret;
 	}
 
@@ -282,16 +629,17 @@ public:
 
 class Scope {
 private:
-	std::unordered_map<std::string, ValuePtr> vars_;
+	std::unordered_map<Atom, ValuePtr> vars_;
 	Scope* parent_;
+	FrameLayout* frame_;
 
 public:
-	Scope(Scope* p): parent_(p)
+	Scope(Scope* p): parent_(p), frame_(p ? p->frame_ : NULL)
 	{}
 	~Scope()
 	{}
 
-	ValuePtr getVar(const std::string& name)
+	ValuePtr getVar(Atom name)
 	{
 		Scope* cur = this;
 		while (cur)
@@ -306,7 +654,7 @@ public:
 		return nullptr;
 	}
 
-	void setVar(const std::string& name, ValuePtr val)
+	void setVar(Atom name, ValuePtr val)
 	{
 		Scope* cur = this;
 		while (cur)
@@ -322,7 +670,21 @@ public:
 		vars_[name] = val;
 	}
 
-	void delVar(const std::string& name)
+	Scope* owner(Atom name)
+	{
+		Scope* cur = this;
+		while (cur)
+		{
+			if (cur->vars_.find(name) != cur->vars_.end())
+			{
+				return cur;
+			}
+			cur = cur->parent_;
+		}
+		return NULL;
+	}
+
+	void delVar(Atom name)
 	{
 		Scope* cur = this;
 		while (cur)
@@ -338,7 +700,45 @@ public:
 	}
 
 	inline Scope* getParent() { return parent_; }
-	inline std::unordered_map<std::string, ValuePtr>& getValueMap() { return vars_; }
+	inline std::unordered_map<Atom, ValuePtr>& getValueMap() { return vars_; }
+	inline FrameLayout* getFrame() { return frame_; }
+	inline void setFrame(FrameLayout* frame) { frame_ = frame; }
+};
+
+/*
+ * One activation of a script function; uncaptured locals live in slots_.
+ * caller_ and site_ (the call node in the caller) chain the script stack;
+ * start_ and children_ are cycle counts kept for CallProfile.
+ */
+struct Frame {
+	std::vector<ValuePtr> slots_;
+	EnvPtr env_;
+	ValuePtr this_;
+	ValuePtr arguments_;
+	Frame* caller_;
+	Function* func_;
+	AST* site_;
+	uint32_t argc_;
+	uint64_t start_;
+	uint64_t children_;
+
+	Frame(): caller_(NULL), func_(NULL), site_(NULL), argc_(0), start_(0), children_(0)
+	{}
+
+	inline ValuePtr& local(const Identifier* id)
+	{
+		if (id->binding_ == Identifier::Binding::SLOT)
+		{
+			return slots_[id->index_];
+		}
+
+		Env* env = env_.get();
+		for (int i = id->depth_; i > 0; --i)
+		{
+			env = env->parent_.get();
+		}
+		return env->cells_[id->index_];
+	}
 };
 
 NAMESPACE_END
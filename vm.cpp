@@ -1,12 +1,54 @@
 #include "vm.h"
 
+#include <fstream>
+
 NAMESPACE_BEGIN
 
-VM::VM()
+static const Atom THIS = atom("this");
+
+static inline bool indexed(const ValuePtr& ref, const ValuePtr& key, uint32_t& index)
+{
+	return (ref->type_ == Value::Type::ARRAY || ref->type_ == Value::Type::TYPED_ARRAY)
+		&& ArrayValue::toIndex(key, index);
+}
+
+static inline ValuePtr getIndex(const ValuePtr& ref, uint32_t index)
+{
+	if (ref->type_ == Value::Type::ARRAY)
+	{
+		return static_cast<ArrayValue*>(ref.get())->getIndex(index);
+	}
+	return static_cast<TypedArrayValue*>(ref.get())->getIndex(index);
+}
+
+static inline void setIndex(const ValuePtr& ref, uint32_t index, const ValuePtr& v)
+{
+	if (ref->type_ == Value::Type::ARRAY)
+	{
+		static_cast<ArrayValue*>(ref.get())->setIndex(index, v);
+	}
+	else
+	{
+		static_cast<TypedArrayValue*>(ref.get())->setIndex(index, v);
+	}
+}
+
+VM::VM(): global_(NULL), frame_(NULL), consts_(NULL)
 {}
 
 VM::~VM()
-{}
+{
+	if (!calls_.path().empty())
+	{
+		std::ofstream out(calls_.path());
+		calls_.write(out);
+	}
+
+	for (auto t : traces_)
+	{
+		delete t;
+	}
+}
 
 void VM::throwUnexpectSignal(ValuePtr v)
 {
@@ -16,37 +58,100 @@ void VM::throwUnexpectSignal(ValuePtr v)
 	throw ExecError(ss.str());
 }
 
+void VM::throwOutOfMemory()
+{
+	std::stringstream ss;
+	ss << "Out of memory: heap limit of " << memory_.limit()
+			<< " bytes reached (" << memory_.used() << " in use)";
+	throw OutOfMemoryError(ss.str());
+}
+
+void VM::preempt()
+{
+	std::stringstream ss;
+	if (budget_.interrupted())
+	{
+		ss << "Script interrupted";
+	}
+	else
+	{
+		ss << "Execution budget of " << budget_.limit() << " steps exhausted";
+	}
+	throw TimeoutError(ss.str());
+}
+
 void VM::exec(Program* prog)
 {
-	std::cout << "Execute a program" << std::endl;
+	Isolate::Enter enter(&isolate_);
+	MemoryAccount::Use use(&memory_);
 
 	global_ = prog->scope_;
+	consts_ = &prog->consts_;
 
-	loadBuiltin();
-
-	for (auto i : *prog->stmts_)
+	try
 	{
-		ValuePtr ret = exec(i);
-		if (ret->type_ == Value::Type::SIGNAL)
+		loadBuiltin();
+
+		for (auto f : prog->hoisted_)
+		{
+			bind(f->id_, closure(f));
+		}
+
+		for (auto i : *prog->stmts_)
 		{
-			if (CAST(Signal, ret)->sigtype_ != Signal::Type::NORMAL)
+			ValuePtr ret = exec(i);
+			if (ret->type_ == Value::Type::SIGNAL)
 			{
-				throwUnexpectSignal(ret);
+				if (CAST(Signal, ret)->sigtype_ != Signal::Type::NORMAL)
+				{
+					throwUnexpectSignal(ret);
+				}
 			}
 		}
 	}
+	catch (std::bad_alloc&)
+	{
+		throwOutOfMemory();
+	}
+}
+
+ValuePtr VM::exec(AST* code)
+{
+	if (code == NULL)
+	{
+		return Signal::sigNormal();
+	}
+
+	if (profiler_.due())
+	{
+		profiler_.sample(frame_, code);
+	}
+
+	if (memory_.tripped() && memory_.check())
+	{
+		throwOutOfMemory();
+	}
 
-	std::cout << "Execution finished" << std::endl;
+	if (!allocs_.active())
+	{
+		return dispatch(code);
+	}
 
-	auto m = prog->scope_->getValueMap();
-	for (auto i : m)
+	AST* prev = allocs_.enter(code);
+	try
+	{
+		ValuePtr ret = dispatch(code);
+		allocs_.leave(prev);
+		return ret;
+	}
+	catch (...)
 	{
-		std::cout << "var: " << i.first
-			<< " == " << i.second->toString() << std::endl;
+		allocs_.leave(prev);
+		throw;
 	}
 }
 
-ValuePtr VM::exec(AST* code)
+ValuePtr VM::dispatch(AST* code)
 {
 	EXEC(Var)
 	EXEC(LiteralString)
@@ -97,8 +202,8 @@ ValuePtr VM::exec(Var* v)
 		{
 			ret = Undefined::instance();
 		}
-		v->scope_->setVar(d->id_->name_, ret);
-		std::cout << "var " << d->id_->name_ << " = " << ret->toString() << std::endl;
+		bind(d->id_, ret);
+		TRACE_EVENT(VAR, d->id_->name_ << " = " << ret->toString());
 	}
 
 	return ret;
@@ -106,17 +211,17 @@ ValuePtr VM::exec(Var* v)
 
 ValuePtr VM::exec(LiteralString* str)
 {
-	return ValuePtr(new StringValue(str->str_));
+	return (*consts_)[str->const_];
 }
 
 ValuePtr VM::exec(LiteralNumber* n)
 {
-	return ValuePtr(new Number(std::stoll(n->data_)));
+	return (*consts_)[n->const_];
 }
 
 ValuePtr VM::exec(LiteralBool* b)
 {
-	return ValuePtr(new Boolean(b->b_));
+	return (*consts_)[b->const_];
 }
 
 ValuePtr VM::exec(LiteralNull* n)
@@ -126,7 +231,12 @@ ValuePtr VM::exec(LiteralNull* n)
 
 ValuePtr VM::exec(Identifier* id)
 {
-	ValuePtr ret = id->scope_->getVar(id->name_);
+	if (id->binding_ != Identifier::Binding::GLOBAL)
+	{
+		return frame_->local(id);
+	}
+
+	ValuePtr ret = id->scope_->getVar(id->atom_);
 	if (ret == NULL)
 	{
 		// std::stringstream ss;
@@ -140,7 +250,28 @@ ValuePtr VM::exec(Identifier* id)
 
 ValuePtr VM::exec(Function* f)
 {
-	return ValuePtr(new FunctionValue(f));
+	if (f->declaration_)
+	{
+		return Signal::sigNormal();
+	}
+	return closure(f);
+}
+
+ValuePtr VM::closure(Function* f)
+{
+	return ValuePtr(new FunctionValue(f, frame_ ? frame_->env_ : nullptr));
+}
+
+void VM::bind(Identifier* id, const ValuePtr& v)
+{
+	if (id->binding_ == Identifier::Binding::GLOBAL)
+	{
+		id->scope_->setVar(id->atom_, v);
+	}
+	else
+	{
+		frame_->local(id) = v;
+	}
 }
 
 ValuePtr VM::exec(Block* b)
@@ -148,7 +279,8 @@ ValuePtr VM::exec(Block* b)
 	for (auto i : *b->stmts_)
 	{
 		auto v = exec(i);
-		if (v->type_ == Value::Type::SIGNAL)
+		if (v->type_ == Value::Type::SIGNAL
+			&& CAST(Signal, v)->sigtype_ != Signal::Type::NORMAL)
 		{
 			return v;
 		}
@@ -215,22 +347,29 @@ ValuePtr VM::exec(Return* r)
 	}
 	else
 	{
-		return Signal::sigReturn(NullValue::instance());
+		return Signal::sigReturn(Undefined::instance());
 	}
 }
 
 ValuePtr VM::exec(ArrayMember* a)
 {
 	ValuePtr attr = exec(a->attr_);
-	std::string key = attr->toString();
-
 	ValuePtr ref = exec(a->base_);
+	uint32_t index;
+
+	if (indexed(ref, attr, index))
+	{
+		return getIndex(ref, index);
+	}
+
+	Key tmp(NO_ATOM);
+	const Key& key = attr->toKey(tmp);
 
 	if (ref->type_ == Value::Type::UNDEFINED
 		|| ref->type_ == Value::Type::NULLVAL)
 	{
 		std::stringstream ss;
-		ss << "Can not get attr [" << key << "] for " << ref->toString()
+		ss << "Can not get attr [" << key.name() << "] for " << ref->toString()
 			<< " at " << a->range_.toString();
 		throw ExecError(ss.str());
 	}
@@ -238,9 +377,52 @@ ValuePtr VM::exec(ArrayMember* a)
 	return ref->getAttr(key);
 }
 
+ValuePtr VM::callNative(NativeFunction* native, const ValuePtr& self,
+	std::list<AST*>* args, bool construct, AST* at)
+{
+	NativeCode code = construct ? native->ctor_ : native->call_;
+
+	TRACE_EVENT(CALL, native->name_ << (construct ? " (new)" : ""));
+
+	if (code == NULL)
+	{
+		std::stringstream ss;
+		ss << native->name_ << (construct ? " is not a constructor" : " requires new")
+			<< " at " << at->range_.toString();
+		throw ExecError(ss.str());
+	}
+
+	std::vector<ValuePtr> argv;
+	argv.reserve(args->size());
+
+	for (auto arg : *args)
+	{
+		argv.push_back(exec(arg));
+	}
+
+	return code(this, self, argv);
+}
+
 ValuePtr VM::exec(Call* c)
 {
-	ValuePtr fv = exec(c->func_);
+	ValuePtr self = Undefined::instance();
+	ValuePtr fv;
+
+	if (c->func_->type_ == AST::Type::OBJECT_MEMBER)
+	{
+		auto o = dynamic_cast<ObjectMember*>(c->func_);
+		self = exec(o->base_);
+		fv = getMember(self, dynamic_cast<Identifier*>(o->attr_)->atom_, o);
+	}
+	else
+	{
+		fv = exec(c->func_);
+	}
+
+	if (CAST(NativeFunction, fv) != nullptr)
+	{
+		return callNative(CAST(NativeFunction, fv).get(), self, c->args_, false, c);
+	}
 
 	if (CAST(FunctionValue, fv) == nullptr)
 	{
@@ -249,61 +431,134 @@ ValuePtr VM::exec(Call* c)
 		throw ExecError(ss.str());
 	}
 
-	auto func = CAST(FunctionValue, fv)->code_;
-	auto rarg = c->args_->begin();
+	return invoke(fv, self, c->args_, c);
+}
 
-	ValuePtr arguments(new ObjectValue);
-	ValuePtr me(new ObjectValue);
-	int i = 0;
+/*
+ * Runs a script function in a fresh activation. Arguments are evaluated
+ * in the caller's frame straight into the callee's parameter storage; the
+ * callee's Env, when it has captured locals, chains to the one the
+ * closure was created in.
+ */
+ValuePtr VM::invoke(const ValuePtr& fv, const ValuePtr& self, std::list<AST*>* args, AST* at)
+{
+	auto fn = static_cast<FunctionValue*>(fv.get());
+	Function* func = fn->code_;
+	FrameLayout* layout = func->layout_;
+
+	TRACE_EVENT(CALL, (func->id_ ? func->id_->name_ : "<anonymous>")
+		<< " at " << func->range_.toString());
 
-	for (auto arg : *func->args_)
+	if (budget_.tick())
 	{
-		if (rarg != c->args_->end())
+		preempt();
+	}
+
+	/* Owns the frame and makes it current once the arguments are in place */
+	struct Activation {
+		VM* vm_;
+		Frame frame_;
+		Activation(VM* vm): vm_(vm)
 		{
-			auto v = exec(*rarg++);
-			func->scope_->setVar(arg->name_, v);
-			arguments->setAttr(std::to_string(i++), v);
+			frame_.caller_ = vm->frame_;
 		}
+		void enter()
+		{
+			vm_->frame_ = &frame_;
+		}
+		~Activation()
+		{
+			vm_->frame_ = frame_.caller_;
+			if (frame_.start_)
+			{
+				vm_->calls_.leave(&frame_);
+			}
+		}
+	} activation(this);
+
+	Frame& frame = activation.frame_;
+	frame.slots_.assign(layout->nslots_, Undefined::instance());
+	frame.env_ = layout->ncells_ ? EnvPtr(new Env(layout->ncells_, fn->env_)) : fn->env_;
+	frame.this_ = self;
+	frame.func_ = func;
+	frame.site_ = at;
+
+	if (func->id_ && !func->declaration_)
+	{
+		frame.local(func->id_) = fv;
+	}
+
+	if (layout->arguments_)
+	{
+		frame.arguments_ = ValuePtr(new ObjectValue);
+	}
+
+	auto param = func->args_->begin();
+	uint32_t i = 0;
+
+	for (auto arg : *args)
+	{
+		ValuePtr v = exec(arg);
+
+		if (frame.arguments_)
+		{
+			frame.arguments_->setAttr(indexKey(i++), v);
+		}
+
+		if (param != func->args_->end())
+		{
+			frame.local(*param++) = std::move(v);
+		}
+	}
+
+	activation.enter();
+
+	if (calls_.active())
+	{
+		frame.argc_ = args->size();
+		calls_.enter(&frame);
 	}
 
-	func->scope_->getValueMap()["arguments"] = arguments;
-	func->scope_->getValueMap()["this"] = me;
+	for (auto f : layout->hoisted_)
+	{
+		frame.local(f->id_) = closure(f);
+	}
 
 	for (auto stmt : *func->stmts_)
 	{
 		auto ret = exec(stmt);
 		if (ret->type_ == Value::Type::SIGNAL)
 		{
-			if (CAST(Signal, ret)->sigtype_ == Signal::Type::RETURN)
-			{
-				return CAST(Signal, ret)->val_;
-			}
-			else if (CAST(Signal, ret)->sigtype_ == Signal::Type::NORMAL)
+			auto sig = static_cast<Signal*>(ret.get());
+			if (sig->sigtype_ == Signal::Type::RETURN)
 			{
-				continue;
+				return std::move(sig->val_);
 			}
-			else
+			else if (sig->sigtype_ != Signal::Type::NORMAL)
 			{
 				throwUnexpectSignal(ret);
 			}
 		}
 	}
 
-	return NullValue::instance();
+	return Undefined::instance();
 }
 
 ValuePtr VM::exec(ObjectMember* o)
 {
-	auto key = dynamic_cast<Identifier*>(o->attr_)->name_;
+	auto key = dynamic_cast<Identifier*>(o->attr_)->atom_;
 
-	ValuePtr ref = exec(o->base_);
+	return getMember(exec(o->base_), key, o);
+}
 
+ValuePtr VM::getMember(const ValuePtr& ref, Atom key, AST* at)
+{
 	if (ref->type_ == Value::Type::UNDEFINED
 		|| ref->type_ == Value::Type::NULLVAL)
 	{
 		std::stringstream ss;
-		ss << "Can not get attr [" << key << "] for " << ref->toString()
-			<< " at " << o->range_.toString();
+		ss << "Can not get attr [" << atomName(key) << "] for " << ref->toString()
+			<< " at " << at->range_.toString();
 		throw ExecError(ss.str());
 	}
 
@@ -312,15 +567,15 @@ ValuePtr VM::exec(ObjectMember* o)
 
 ValuePtr VM::exec(Array* arr)
 {
-	ValuePtr ret(new ObjectValue());
-	int i = 0;
+	auto ret = new ArrayValue();
+	ValuePtr hold(ret);
 
 	for (auto e : *arr->elem_)
 	{
-		ret->setAttr(std::to_string(i++), exec(e));
+		ret->push(exec(e));
 	}
 
-	return ret;
+	return hold;
 }
 
 ValuePtr VM::exec(Object* obj)
@@ -329,7 +584,16 @@ ValuePtr VM::exec(Object* obj)
 
 	for (auto p : *obj->kv_)
 	{
-		ret->setAttr(exec(p.first)->toString(), exec(p.second));
+		if (p.first->type_ == AST::Type::IDENTIFIER)
+		{
+			ret->setAttr(dynamic_cast<Identifier*>(p.first)->atom_, exec(p.second));
+			continue;
+		}
+
+		Key tmp(NO_ATOM);
+		ValuePtr name = exec(p.first);
+		const Key& key = name->toKey(tmp);
+		ret->setAttr(key, exec(p.second));
 	}
 
 	return ret;
@@ -337,7 +601,13 @@ ValuePtr VM::exec(Object* obj)
 
 ValuePtr VM::exec(Keyword* kw)
 {
-	return kw->scope_->getVar(kw->data_);
+	if (kw->scope_->getFrame())
+	{
+		return kw->atom_ == THIS ? frame_->this_ : frame_->arguments_;
+	}
+
+	ValuePtr ret = kw->scope_->getVar(kw->atom_);
+	return ret ? ret : Undefined::instance();
 }
 
 ValuePtr VM::exec(Constructor* c)
@@ -346,6 +616,12 @@ ValuePtr VM::exec(Constructor* c)
 
 	ValuePtr fv = exec(called->func_);
 
+	if (CAST(NativeFunction, fv) != nullptr)
+	{
+		return callNative(CAST(NativeFunction, fv).get(), Undefined::instance(),
+			called->args_, true, called);
+	}
+
 	if (CAST(FunctionValue, fv) == nullptr)
 	{
 		std::stringstream ss;
@@ -353,45 +629,9 @@ ValuePtr VM::exec(Constructor* c)
 		throw ExecError(ss.str());
 	}
 
-	auto func = CAST(FunctionValue, fv)->code_;
-	auto rarg = called->args_->begin();
-
-	ValuePtr arguments(new ObjectValue);
 	ValuePtr me(new ObjectValue);
-	int i = 0;
-
-	for (auto arg : *func->args_)
-	{
-		if (rarg != called->args_->end())
-		{
-			auto v = exec(*rarg++);
-			func->scope_->setVar(arg->name_, v);
-			arguments->setAttr(std::to_string(i++), v);
-		}
-	}
 
-	func->scope_->getValueMap()["arguments"] = arguments;
-	func->scope_->getValueMap()["this"] = me;
-
-	for (auto stmt : *func->stmts_)
-	{
-		auto ret = exec(stmt);
-		if (ret->type_ == Value::Type::SIGNAL)
-		{
-			if (CAST(Signal, ret)->sigtype_ == Signal::Type::RETURN)
-			{
-				break;
-			}
-			else if (CAST(Signal, ret)->sigtype_ == Signal::Type::NORMAL)
-			{
-				continue;
-			}
-			else
-			{
-				throwUnexpectSignal(ret);
-			}
-		}
-	}
+	invoke(fv, me, called->args_, called);
 
 	return me;
 }
@@ -410,7 +650,8 @@ ValuePtr VM::exec(Switch* sw)
 		if (stmt->type_ == AST::Type::CASE)
 		{
 			if (dynamic_cast<Case*>(stmt)->expr_ == NULL
-				|| eq(exec(dynamic_cast<Case*>(stmt)->expr_), val))
+				|| operate(BiExpression::Op::EQ,
+					exec(dynamic_cast<Case*>(stmt)->expr_), val)->toBool())
 			{
 				state = EXECUTE;
 			}
@@ -429,7 +670,7 @@ ValuePtr VM::exec(Switch* sw)
 				{
 					break;
 				}
-				else
+				else if (CAST(Signal, ret)->sigtype_ != Signal::Type::NORMAL)
 				{
 					return ret;
 				}
@@ -445,6 +686,11 @@ ValuePtr VM::exec(DoLoop* dl)
 	ValuePtr check = nullptr;
 	do
 	{
+		if (budget_.tick())
+		{
+			preempt();
+		}
+
 		auto ret = exec(dl->blk_);
 		if (ret->type_ == Value::Type::SIGNAL)
 		{
@@ -466,8 +712,14 @@ ValuePtr VM::exec(DoLoop* dl)
 
 ValuePtr VM::exec(Loop* lp)
 {
-	while (exec(lp->cond_)->toBool())
+	while (!runTrace(lp->hot_, lp->cond_, lp->stmt_, NULL)
+		&& exec(lp->cond_)->toBool())
 	{
+		if (budget_.tick())
+		{
+			preempt();
+		}
+
 		auto ret = exec(lp->stmt_);
 		if (ret->type_ == Value::Type::SIGNAL)
 		{
@@ -489,8 +741,14 @@ ValuePtr VM::exec(ForLoop* fl)
 {
 	exec(fl->init_);
 
-	while (exec(fl->cond_)->toBool())
+	while (!runTrace(fl->hot_, fl->cond_, fl->stmt_, fl->iter_)
+		&& exec(fl->cond_)->toBool())
 	{
+		if (budget_.tick())
+		{
+			preempt();
+		}
+
 		auto ret = exec(fl->stmt_);
 		if (ret->type_ == Value::Type::SIGNAL)
 		{
@@ -510,20 +768,72 @@ ValuePtr VM::exec(ForLoop* fl)
 	return Signal::sigNormal(); 
 }
 
+bool VM::runTrace(LoopInfo& hot, AST* cond, AST* stmt, AST* iter)
+{
+	if (hot.blacklisted_)
+	{
+		return false;
+	}
+
+	if (hot.trace_ == NULL)
+	{
+		if (++hot.hits_ < LoopTrace::HOT_LOOP)
+		{
+			return false;
+		}
+
+		TraceRecorder rec(this);
+
+		switch (rec.record(cond, stmt, iter))
+		{
+			case TraceRecorder::Status::RECORDED:
+				hot.trace_ = rec.release();
+				hot.exits_ = 0;
+				++hot.records_;
+				traces_.push_back(hot.trace_);
+				break;
+			case TraceRecorder::Status::LOOP_EXIT:
+				return false;
+			default:
+				hot.blacklisted_ = true;
+				return false;
+		}
+	}
+
+	switch (hot.trace_->run(frame_, budget_))
+	{
+		case LoopTrace::Result::LOOP_DONE:
+			return true;
+		case LoopTrace::Result::PREEMPTED:
+			preempt();
+		default:
+			break;
+	}
+
+	if (++hot.exits_ > LoopTrace::MAX_SIDE_EXITS)
+	{
+		hot.trace_ = NULL;
+		hot.hits_ = 0;
+		hot.blacklisted_ = hot.records_ >= LoopTrace::MAX_RECORDS;
+	}
+
+	return false;
+}
+
 ValuePtr VM::exec(ForInLoop* fi)
 {
-	std::string i;
+	Identifier* i;
 
 	exec(fi->key_);
 
 	if (fi->key_->type_ == AST::Type::VAR)
 	{
 		auto var = dynamic_cast<Var*>(fi->key_);
-		i = (*var->vlist_->begin())->id_->name_;
+		i = (*var->vlist_->begin())->id_;
 	}
 	else if (fi->key_->type_ == AST::Type::IDENTIFIER)
 	{
-		i = dynamic_cast<Identifier*>(fi->key_)->name_;
+		i = dynamic_cast<Identifier*>(fi->key_);
 	}
 	else
 	{
@@ -544,13 +854,17 @@ ValuePtr VM::exec(ForInLoop* fi)
 
 	if (obj->type_ == Value::Type::STRING)
 	{
-		auto s = CAST(StringValue, obj)->str_;
+		auto s = static_cast<StringValue*>(obj.get());
+		const char* data = s->data();
 
-		for (auto c : s)
+		for (size_t n = 0; n < s->length(); ++n)
 		{
-			std::string tmp(1, c);
-			auto v = ValuePtr(new StringValue(tmp));
-			fi->scope_->setVar(i, v);
+			if (budget_.tick())
+			{
+				preempt();
+			}
+
+			bind(i, StringValue::character(data[n]));
 			auto ret = exec(fi->stmt_);
 			if (ret->type_ == Value::Type::SIGNAL)
 			{
@@ -572,7 +886,12 @@ ValuePtr VM::exec(ForInLoop* fi)
 
 	for (auto key : keys)
 	{
-		fi->scope_->setVar(i, obj->getAttr(key));
+		if (budget_.tick())
+		{
+			preempt();
+		}
+
+		bind(i, obj->getAttr(key));
 		auto ret = exec(fi->stmt_);
 		if (ret->type_ == Value::Type::SIGNAL)
 		{
@@ -602,22 +921,32 @@ ValuePtr VM::exec(UniExpression* u)
 	{
 		if (u->expr_->type_ == AST::Type::IDENTIFIER)
 		{
-			u->scope_->delVar(dynamic_cast<Identifier*>(u->expr_)->name_);
+			u->scope_->delVar(dynamic_cast<Identifier*>(u->expr_)->atom_);
 			return ValuePtr(new Boolean(true));
 		}
 		else if (u->expr_->type_ == AST::Type::ARRAY_MEMBER)
 		{
 			ValuePtr attr = exec(dynamic_cast<ArrayMember*>(u->expr_)->attr_);
-			std::string key = attr->toString();
-
 			ValuePtr ref = exec(dynamic_cast<ArrayMember*>(u->expr_)->base_);
+			uint32_t index;
 
-			ref->delAttr(key);
+			if (indexed(ref, attr, index))
+			{
+				if (ref->type_ == Value::Type::ARRAY)
+				{
+					static_cast<ArrayValue*>(ref.get())->delIndex(index);
+				}
+			}
+			else
+			{
+				Key tmp(NO_ATOM);
+				ref->delAttr(attr->toKey(tmp));
+			}
 			return ValuePtr(new Boolean(true));
 		}
 		else if (u->expr_->type_ == AST::Type::OBJECT_MEMBER)
 		{
-			std::string key = dynamic_cast<Identifier*>(dynamic_cast<ObjectMember*>(u->expr_)->attr_)->name_;
+			Atom key = dynamic_cast<Identifier*>(dynamic_cast<ObjectMember*>(u->expr_)->attr_)->atom_;
 
 			ValuePtr ref = exec(dynamic_cast<ObjectMember*>(u->expr_)->base_);
 
@@ -630,70 +959,58 @@ ValuePtr VM::exec(UniExpression* u)
 		}
 	}
 
-	auto v = exec(u->expr_);
+	if (u->op_ == "++")
+	{
+		return update(u, 1);
+	}
 
-	if (u->pre_)
+	if (u->op_ == "--")
 	{
-		if (u->op_ == "++")
-		{
-			if (v->type_ == Value::Type::NUMBER)
-			{
-				if (CAST(Number, v) != nullptr)
-				{
-					++(CAST(Number, v)->num_);
-					return v;
-				}
-			}
+		return update(u, -1);
+	}
 
-			return NotaNumber::instance();
-		}
+	auto v = exec(u->expr_);
 
-		if (u->op_ == "--")
+	if (u->pre_)
+	{
+		if (u->op_ == "+")
 		{
 			if (v->type_ == Value::Type::NUMBER)
 			{
-				if (CAST(Number, v) != nullptr)
-				{
-					--(CAST(Number, v)->num_);
-					return v;
-				}
+				return v;
 			}
-
-			return NotaNumber::instance();
-		}
-
-		if (u->op_ == "+")
-		{
-			return v;
+			double d = v->toNumber();
+			return std::isnan(d) ? NotaNumber::instance() : ValuePtr(new Number(d));
 		}
 
 		if (u->op_ == "-")
 		{
 			if (v->type_ == Value::Type::NUMBER)
 			{
-				if (CAST(Number, v) != nullptr)
+				auto n = CAST(Number, v);
+				if (n != nullptr)
 				{
-					ValuePtr ret(new Number(-CAST(Number, v)->num_));
+					if (n->isInt_ && n->int_ != 0 && n->int_ != INT32_MIN)
+					{
+						return ValuePtr(new Number(-n->int_));
+					}
+					ValuePtr ret(new Number(-n->num_));
 					return ret;
 				}
 			}
 
-			return NotaNumber::instance();
+			double d = v->toNumber();
+			return std::isnan(d) ? NotaNumber::instance() : ValuePtr(new Number(-d));
 		}
 
 		if (u->op_ == "~")
 		{
-			int64_t n = 0;
-
-			if (v->type_ == Value::Type::NUMBER)
+			if (CAST(Number, v) != nullptr && CAST(Number, v)->isInt_)
 			{
-				if (CAST(Number, v) != nullptr)
-				{
-					n = int64_t(CAST(Number, v)->num_);
-				}
+				return ValuePtr(new Number(~CAST(Number, v)->int_));
 			}
 
-			return ValuePtr(new Number(~n));
+			return ValuePtr(new Number(~wrap32(v->toNumber())));
 		}
 
 		if (u->op_ == "!")
@@ -712,96 +1029,91 @@ ValuePtr VM::exec(UniExpression* u)
 			return ValuePtr(new StringValue(t));
 		}
 	}
-	else
-	{
-		if (u->op_ == "++")
-		{
-			if (v->type_ == Value::Type::NUMBER)
-			{
-				if (CAST(Number, v) != nullptr)
-				{
-					ValuePtr ret(new Number(CAST(Number, v)->num_));
-					++(CAST(Number, v)->num_);
-					return ret;
-				}
-			}
-
-			return NotaNumber::instance();
-		}
-
-		if (u->op_ == "--")
-		{
-			if (v->type_ == Value::Type::NUMBER)
-			{
-				if (CAST(Number, v) != nullptr)
-				{
-					ValuePtr ret(new Number(CAST(Number, v)->num_));
-					--(CAST(Number, v)->num_);
-					return ret;
-				}
-			}
-
-			return NotaNumber::instance();
-		}
-	}
 
 	std::stringstream ss;
 	ss << "Can not execute unary-expression at " << u->range_.toString();
 	throw ExecError(ss.str());
 }
 
+static inline bool isPrimitive(const ValuePtr& v)
+{
+	return v->type_ != Value::Type::OBJECT
+		&& v->type_ != Value::Type::FUNCTION
+		&& v->type_ != Value::Type::ARRAY
+		&& v->type_ != Value::Type::TYPED_ARRAY;
+}
+
 ValuePtr VM::assign(AST* left, ValuePtr v)
 {
 	if (left->type_ == AST::Type::IDENTIFIER)
 	{
-		if (left->scope_->getVar(dynamic_cast<Identifier*>(left)->name_) == nullptr)
+		auto id = dynamic_cast<Identifier*>(left);
+		Atom name = id->atom_;
+		if (id->binding_ != Identifier::Binding::GLOBAL)
+		{
+			frame_->local(id) = v;
+		}
+		else if (left->scope_->getVar(name) == nullptr)
 		{
-			global_->setVar(dynamic_cast<Identifier*>(left)->name_, v);
+			global_->setVar(name, v);
 		}
 		else
 		{
-			left->scope_->setVar(dynamic_cast<Identifier*>(left)->name_, v);
+			left->scope_->setVar(name, v);
 		}
 
-		std::cout << "assign " << dynamic_cast<Identifier*>(left)->name_
-				<< " = " << v->toString() << std::endl;
+		TRACE_EVENT(ASSIGN, id->name_ << " = " << v->toString());
 
 		return v;
 	}
 	else if (left->type_ == AST::Type::ARRAY_MEMBER)
 	{
 		ValuePtr attr = exec(dynamic_cast<ArrayMember*>(left)->attr_);
-		std::string key = attr->toString();
-
 		ValuePtr ref = exec(dynamic_cast<ArrayMember*>(left)->base_);
+		uint32_t index;
+
+		if (indexed(ref, attr, index))
+		{
+			setIndex(ref, index, v);
+			return v;
+		}
+
+		Key tmp(NO_ATOM);
+		const Key& key = attr->toKey(tmp);
 
 		if (ref->type_ == Value::Type::UNDEFINED
 			|| ref->type_ == Value::Type::NULLVAL)
 		{
 			std::stringstream ss;
-			ss << "Can not set attr [" << key << "] for " << ref->toString()
+			ss << "Can not set attr [" << key.name() << "] for " << ref->toString()
 				<< " at " << left->range_.toString();
 			throw ExecError(ss.str());
 		}
 
-		ref->setAttr(key, v);
+		if (!isPrimitive(ref))
+		{
+			ref->setAttr(key, v);
+		}
 		return v;
 	}
 	else if (left->type_ == AST::Type::OBJECT_MEMBER)
 	{
-		std::string key = dynamic_cast<Identifier*>(dynamic_cast<ObjectMember*>(left)->attr_)->name_;
+		Atom key = dynamic_cast<Identifier*>(dynamic_cast<ObjectMember*>(left)->attr_)->atom_;
 		ValuePtr ref = exec(dynamic_cast<ObjectMember*>(left)->base_);
 
 		if (ref->type_ == Value::Type::UNDEFINED
 			|| ref->type_ == Value::Type::NULLVAL)
 		{
 			std::stringstream ss;
-			ss << "Can not set attr [" << key << "] for " << ref->toString()
+			ss << "Can not set attr [" << atomName(key) << "] for " << ref->toString()
 				<< " at " << left->range_.toString();
 			throw ExecError(ss.str());
 		}
 
-		ref->setAttr(key, v);
+		if (!isPrimitive(ref))
+		{
+			ref->setAttr(key, v);
+		}
 		return v;
 	}
 	else
@@ -813,313 +1125,158 @@ ValuePtr VM::assign(AST* left, ValuePtr v)
 	}
 }
 
-ValuePtr VM::plus(ValuePtr left, ValuePtr right)
+ValuePtr VM::rev(ValuePtr v)
 {
-	if (CAST(NotaNumber, left) || CAST(NotaNumber, right))
-	{
-		return NotaNumber::instance();
-	}
-	else if (left->type_ == Value::Type::NUMBER
-			&& right->type_ == Value::Type::NUMBER)
-	{
-		return ValuePtr(new Number(CAST(Number, left)->num_
-								+ CAST(Number, right)->num_));
-	}
-	else
-	{
-		auto s = left->toString() + right->toString();
-		return ValuePtr(new StringValue(s));
-	}
+	return ValuePtr(new Number(~wrap32(v->toNumber())));
 }
 
-ValuePtr VM::minus(ValuePtr left, ValuePtr right)
+static inline bool isNumber(const ValuePtr& v)
 {
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(CAST(Number, left)->num_
-								- CAST(Number, right)->num_));
-	}
-	else
-	{
-		return NotaNumber::instance();
-	}
+	return v->type_ == Value::Type::NUMBER
+		&& v.get() != NotaNumber::instance().get();
 }
 
-ValuePtr VM::mul(ValuePtr left, ValuePtr right)
+ValuePtr VM::update(UniExpression* u, int32_t delta)
 {
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(CAST(Number, left)->num_
-								* CAST(Number, right)->num_));
-	}
-	else
-	{
-		return NotaNumber::instance();
-	}
-}
+	ValuePtr ref, old, attr;
+	Key tmp(NO_ATOM);
+	const Key* key = &tmp;
+	bool element = false;
+	uint32_t index = 0;
 
-ValuePtr VM::div(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(CAST(Number, left)->num_
-								/ CAST(Number, right)->num_));
-	}
-	else
+	if (u->expr_->type_ == AST::Type::ARRAY_MEMBER)
 	{
-		return NotaNumber::instance();
-	}
-}
+		attr = exec(dynamic_cast<ArrayMember*>(u->expr_)->attr_);
+		ref = exec(dynamic_cast<ArrayMember*>(u->expr_)->base_);
 
-ValuePtr VM::mod(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(int64_t(CAST(Number, left)->num_)
-								% int64_t(CAST(Number, right)->num_)));
+		element = indexed(ref, attr, index);
+		if (!element)
+		{
+			key = &attr->toKey(tmp);
+		}
 	}
-	else
+	else if (u->expr_->type_ == AST::Type::OBJECT_MEMBER)
 	{
-		return NotaNumber::instance();
+		tmp = dynamic_cast<Identifier*>(dynamic_cast<ObjectMember*>(u->expr_)->attr_)->atom_;
+		ref = exec(dynamic_cast<ObjectMember*>(u->expr_)->base_);
 	}
-}
 
-ValuePtr VM::band(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(int64_t(CAST(Number, left)->num_)
-								& int64_t(CAST(Number, right)->num_)));
-	}
-	else
+	if (element)
 	{
-		return NotaNumber::instance();
+		old = getIndex(ref, index);
 	}
-}
-
-ValuePtr VM::bor(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
+	else if (ref)
 	{
-		return ValuePtr(new Number(int64_t(CAST(Number, left)->num_)
-								| int64_t(CAST(Number, right)->num_)));
+		if (ref->type_ == Value::Type::UNDEFINED
+			|| ref->type_ == Value::Type::NULLVAL)
+		{
+			std::stringstream ss;
+			ss << "Can not get attr [" << key->name() << "] for " << ref->toString()
+				<< " at " << u->expr_->range_.toString();
+			throw ExecError(ss.str());
+		}
+		old = ref->getAttr(*key);
 	}
 	else
 	{
-		return NotaNumber::instance();
+		old = exec(u->expr_);
 	}
-}
 
-ValuePtr VM::bxor(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(int64_t(CAST(Number, left)->num_)
-								^ int64_t(CAST(Number, right)->num_)));
-	}
-	else
+	if (!isNumber(old))
 	{
 		return NotaNumber::instance();
 	}
-}
 
-ValuePtr VM::rev(ValuePtr v)
-{
-	if (v->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, v) == nullptr)
-	{
-		return ValuePtr(new Number(~int64_t(CAST(Number, v)->num_)));
-	}
-	else
-	{
-		return NotaNumber::instance();
-	}
-}
+	const Number* n = static_cast<const Number*>(old.get());
+	int32_t r;
+	ValuePtr now(n->isInt_ && !__builtin_add_overflow(n->int_, delta, &r)
+		? new Number(r) : new Number(n->num_ + delta));
 
-ValuePtr VM::lshift(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Number(int64_t(CAST(Number, left)->num_)
-								<< int64_t(CAST(Number, right)->num_)));
-	}
-	else
+	if (element)
 	{
-		return NotaNumber::instance();
+		setIndex(ref, index, now);
 	}
-}
-
-ValuePtr VM::rshift(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
+	else if (ref)
 	{
-		return ValuePtr(new Number(int64_t(CAST(Number, left)->num_)
-								>> int64_t(CAST(Number, right)->num_)));
+		if (!isPrimitive(ref))
+		{
+			ref->setAttr(*key, now);
+		}
 	}
 	else
 	{
-		return NotaNumber::instance();
+		assign(u->expr_, now);
 	}
-}
 
-ValuePtr VM::eq(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								== CAST(Number, right)->num_));
-	}
-	else
-	{
-		return ValuePtr(new Boolean(left->toString() == right->toString()));
-	}
+	return u->pre_ ? now : old;
 }
 
-ValuePtr VM::neq(ValuePtr left, ValuePtr right)
+static BiExpression::Kind observe(BiExpression::Op op,
+	const ValuePtr& left, const ValuePtr& right)
 {
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								!= CAST(Number, right)->num_));
-	}
-	else
+	if (isNumber(left) && isNumber(right))
 	{
-		return ValuePtr(new Boolean(left->toString() != right->toString()));
+		return BiExpression::Kind::NUM_NUM;
 	}
-}
 
-ValuePtr VM::ls(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								< CAST(Number, right)->num_));
-	}
-	else
+	if (left->type_ == Value::Type::STRING
+		&& right->type_ == Value::Type::STRING
+		&& (op == BiExpression::Op::PLUS
+			|| (op >= BiExpression::Op::LS && op <= BiExpression::Op::NTEQ)))
 	{
-		return ValuePtr(new Boolean(left->toString() < right->toString()));
+		return BiExpression::Kind::STR_STR;
 	}
-}
 
-ValuePtr VM::le(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								<= CAST(Number, right)->num_));
-	}
-	else
-	{
-		return ValuePtr(new Boolean(left->toString() <= right->toString()));
-	}
+	return BiExpression::Kind::GENERIC;
 }
 
-ValuePtr VM::gt(ValuePtr left, ValuePtr right)
+ValuePtr VM::binary(BiExpression* bi, const ValuePtr& left, const ValuePtr& right)
 {
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								> CAST(Number, right)->num_));
-	}
-	else
+	switch (bi->kind_)
 	{
-		return ValuePtr(new Boolean(left->toString() > right->toString()));
-	}
-}
+		case BiExpression::Kind::NUM_NUM:
+			if (isNumber(left) && isNumber(right))
+			{
+				return kernel(bi->opcode_, Value::Type::NUMBER,
+					Value::Type::NUMBER)(left, right);
+			}
+			bi->kind_ = BiExpression::Kind::GENERIC;
+			break;
 
-ValuePtr VM::ge(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								>= CAST(Number, right)->num_));
-	}
-	else
-	{
-		return ValuePtr(new Boolean(left->toString() >= right->toString()));
-	}
-}
+		case BiExpression::Kind::STR_STR:
+			if (left->type_ == Value::Type::STRING
+				&& right->type_ == Value::Type::STRING)
+			{
+				return kernel(bi->opcode_, Value::Type::STRING,
+					Value::Type::STRING)(left, right);
+			}
+			bi->kind_ = BiExpression::Kind::GENERIC;
+			break;
 
-ValuePtr VM::teq(ValuePtr left, ValuePtr right)
-{
-	if (left->type_ != right->type_)
-	{
-		return ValuePtr(new Boolean(false));
-	}
-	if (left->type_ == Value::Type::NUMBER
-		&& right->type_ == Value::Type::NUMBER
-		&& CAST(NotaNumber, left) == nullptr
-		&& CAST(NotaNumber, right) == nullptr)
-	{
-		return ValuePtr(new Boolean(CAST(Number, left)->num_
-								== CAST(Number, right)->num_));
-	}
-	else
-	{
-		return ValuePtr(new Boolean(left->toString() == right->toString()));
+		case BiExpression::Kind::UNINIT:
+			bi->kind_ = observe(bi->opcode_, left, right);
+			if (bi->kind_ != BiExpression::Kind::GENERIC)
+			{
+				return binary(bi, left, right);
+			}
+			break;
+
+		default:
+			break;
 	}
-}
 
-ValuePtr VM::nteq(ValuePtr left, ValuePtr right)
-{
-	auto r = teq(left, right);
-	return ValuePtr(new Boolean(!CAST(Boolean, r)->b_));
+	return operate(bi->opcode_, left, right);
 }
 
 ValuePtr VM::exec(BiExpression* bi)
 {
-	if (bi->op_ == "&&")
+	if (bi->opcode_ == BiExpression::Op::AND)
 	{
 		auto b = exec(bi->left_)->toBool() && exec(bi->right_)->toBool();
 		return ValuePtr(new Boolean(b));
 	}
 
-	if (bi->op_ == "||")
+	if (bi->opcode_ == BiExpression::Op::OR)
 	{
 		auto b = exec(bi->left_)->toBool() || exec(bi->right_)->toBool();
 		return ValuePtr(new Boolean(b));
@@ -1127,161 +1284,33 @@ ValuePtr VM::exec(BiExpression* bi)
 
 	ValuePtr rval = exec(bi->right_);
 
-	if (bi->op_ == "=")
+	if (bi->opcode_ == BiExpression::Op::ASSIGN)
 	{
 		return assign(bi->left_, rval);
 	}
 
 	ValuePtr lval = exec(bi->left_);
 
-	if (bi->op_ == "+=")
-	{
-		return assign(bi->left_, plus(lval, rval));
-	}
-
-	if (bi->op_ == "-=")
-	{
-		return assign(bi->left_, minus(lval, rval));
-	}
-
-	if (bi->op_ == "*=")
-	{
-		return assign(bi->left_, mul(lval, rval));
-	}
-
-	if (bi->op_ == "/=")
-	{
-		return assign(bi->left_, div(lval, rval));
-	}
-
-	if (bi->op_ == "%=")
-	{
-		return assign(bi->left_, mod(lval, rval));
-	}
-
-	if (bi->op_ == "&=")
-	{
-		return assign(bi->left_, band(lval, rval));
-	}
-
-	if (bi->op_ == "|=")
-	{
-		return assign(bi->left_, bor(lval, rval));
-	}
-
-	if (bi->op_ == "~=")
+	if (bi->opcode_ == BiExpression::Op::REV)
 	{
 		return assign(bi->left_, rev(rval));
 	}
 
-	if (bi->op_ == "^=")
-	{
-		return assign(bi->left_, bxor(lval, rval));
-	}
-
-	if (bi->op_ == "<<=")
-	{
-		return assign(bi->left_, lshift(lval, rval));
-	}
-
-	if (bi->op_ == ">>=")
-	{
-		return assign(bi->left_, rshift(lval, rval));
-	}
-
-	if (bi->op_ == "+")
-	{
-		return plus(lval, rval);
-	}
-
-	if (bi->op_ == "-")
-	{
-		return minus(lval, rval);
-	}
-
-	if (bi->op_ == "*")
-	{
-		return mul(lval, rval);
-	}
-
-	if (bi->op_ == "/")
-	{
-		return div(lval, rval);
-	}
-
-	if (bi->op_ == "%")
-	{
-		return mod(lval, rval);
-	}
-
-	if (bi->op_ == "&")
-	{
-		return band(lval, rval);
-	}
-
-	if (bi->op_ == "|")
-	{
-		return bor(lval, rval);
-	}
-
-	if (bi->op_ == "^")
+	if (bi->opcode_ == BiExpression::Op::UNKNOWN)
 	{
-		return bxor(lval, rval);
-	}
-
-	if (bi->op_ == "<<")
-	{
-		return lshift(lval, rval);
-	}
-
-	if (bi->op_ == ">>")
-	{
-		return rshift(lval, rval);
-	}
-
-	if (bi->op_ == "<")
-	{
-		return ls(lval, rval);
-	}
-
-	if (bi->op_ == "<=")
-	{
-		return le(lval, rval);
-	}
-
-	if (bi->op_ == ">")
-	{
-		return gt(lval, rval);
-	}
-
-	if (bi->op_ == ">=")
-	{
-		return ge(lval, rval);
-	}
-
-	if (bi->op_ == "==")
-	{
-		return eq(lval, rval);
-	}
-
-	if (bi->op_ == "!=")
-	{
-		return neq(lval, rval);
+		std::stringstream ss;
+		ss << "Can not execute binary-expression at " << bi->range_.toString();
+		throw ExecError(ss.str());
 	}
 
-	if (bi->op_ == "===")
-	{
-		return teq(lval, rval);
-	}
+	ValuePtr ret = binary(bi, lval, rval);
 
-	if (bi->op_ == "!==")
+	if (bi->compound_)
 	{
-		return nteq(lval, rval);
+		return assign(bi->left_, ret);
 	}
 
-	std::stringstream ss;
-	ss << "Can not execute binary-expression at " << bi->range_.toString();
-	throw ExecError(ss.str());
+	return ret;
 }
 
 ValuePtr VM::exec(TriExpression* tri)
@@ -1303,7 +1332,10 @@ ValuePtr VM::exec(TriExpression* tri)
 
 void VM::loadBuiltin()
 {
-	global_->setVar("undefined", Undefined::instance());
+	global_->setVar(atom("undefined"), Undefined::instance());
+	loadTypedArrays(global_);
+	loadStrings();
+	loadConsole(global_);
 	// global_->setVar("window", ValuePtr(new ObjectValue()));
 }
 
@@ -2,6 +2,13 @@
 #define _VM_H_
 
 #include "parser.h"
+#include "hotloop.h"
+#include "kernel.h"
+#include "typedarray.h"
+#include "stringproto.h"
+#include "output.h"
+#include "profiler.h"
+#include "memory.h"
 
 NAMESPACE_BEGIN
 
@@ -19,19 +26,50 @@ public:
 	}
 };
 
+/* The script passed its VM's hard memory limit */
+class OutOfMemoryError: public ExecError
+{
+public:
+	OutOfMemoryError(std::string msg): ExecError(msg)
+	{}
+};
+
+/* The script ran out of steps or was interrupted by the host */
+class TimeoutError: public ExecError
+{
+public:
+	TimeoutError(std::string msg): ExecError(msg)
+	{}
+};
+
 #define CAST(type, ptr) (std::dynamic_pointer_cast<type>(ptr))
 #define EXEC_DECL(type) ValuePtr exec(type* code);
 #define EXEC(type) {if (dynamic_cast<type*>(code)) {\
 				return exec(dynamic_cast<type*>(code));}}
-#define BOP_DECL(func) ValuePtr func(ValuePtr left, ValuePtr right);
 
 class VM {
 private:
+	friend class TraceRecorder;
+	friend class HeapSnapshot;
+
+	Isolate isolate_;
 	Scope* global_;
+	Frame* frame_;
+	const std::vector<ValuePtr>* consts_;
+	std::vector<LoopTrace*> traces_;
+	Output output_;
+	Profiler profiler_;
+	CallProfile calls_;
+	AllocProfile allocs_;
+	MemoryAccount memory_;
+	ExecBudget budget_;
 
 	void throwUnexpectSignal(ValuePtr sig);
+	void throwOutOfMemory();
+	void preempt();
 
 	EXEC_DECL(AST)
+	ValuePtr dispatch(AST* code);
 	EXEC_DECL(Var)
 	EXEC_DECL(LiteralString)
 	EXEC_DECL(LiteralNumber)
@@ -62,29 +100,21 @@ private:
 	EXEC_DECL(BiExpression)
 	EXEC_DECL(TriExpression)
 
+	ValuePtr closure(Function* f);
+	void bind(Identifier* id, const ValuePtr& v);
+	ValuePtr invoke(const ValuePtr& fv, const ValuePtr& self, std::list<AST*>* args, AST* at);
+	ValuePtr getMember(const ValuePtr& ref, Atom key, AST* at);
+	ValuePtr callNative(NativeFunction* native, const ValuePtr& self,
+		std::list<AST*>* args, bool construct, AST* at);
 	ValuePtr assign(AST* left, ValuePtr rval);
+	ValuePtr update(UniExpression* u, int32_t delta);
 
-	BOP_DECL(plus)
-	BOP_DECL(minus)
-	BOP_DECL(mul)
-	BOP_DECL(div)
-	BOP_DECL(mod)
-	BOP_DECL(band)
-	BOP_DECL(bor)
-	BOP_DECL(bxor)
-	BOP_DECL(ls)
-	BOP_DECL(le)
-	BOP_DECL(gt)
-	BOP_DECL(ge)
-	BOP_DECL(eq)
-	BOP_DECL(neq)
-	BOP_DECL(teq)
-	BOP_DECL(nteq)
-	BOP_DECL(lshift)
-	BOP_DECL(rshift)
+	bool runTrace(LoopInfo& hot, AST* cond, AST* stmt, AST* iter);
 
 	ValuePtr rev(ValuePtr v);
 
+	ValuePtr binary(BiExpression* bi, const ValuePtr& left, const ValuePtr& right);
+
 	void loadBuiltin();
 
 public:
@@ -92,6 +122,14 @@ public:
 	~VM();
 
 	void exec(Program* prog);
+
+	inline Output& output() { return output_; }
+	inline Profiler& profiler() { return profiler_; }
+	inline CallProfile& calls() { return calls_; }
+	inline AllocProfile& allocs() { return allocs_; }
+	inline MemoryAccount& memory() { return memory_; }
+	inline ExecBudget& budget() { return budget_; }
+	inline Isolate& isolate() { return isolate_; }
 };
 
 NAMESPACE_END